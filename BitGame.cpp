@@ -0,0 +1,317 @@
+/*
+    Implements BitGame.hpp.
+*/
+
+#include "BitGame.hpp"
+#include "Talon.hpp"
+
+namespace KSolveNames {
+
+BitGame::BitGame(CardDeck deck,unsigned draw,unsigned recycleLimit)
+    : _drawSetting(draw)
+    , _recycleLimit(recycleLimit)
+    , _deck(deck)
+{
+    Deal();
+}
+
+// Deal the cards as Game::Deal() does and build the card sets
+void BitGame::Deal() noexcept
+{
+    assert(_deck.size() == CardsPerDeck);
+    _kingSpaces = 0;
+    _recycleCount = 0;
+    _domMovesCache.clear();
+
+    for (auto& pile: _tableau) pile.clear();
+    auto iDeck = _deck.cbegin();
+    for (unsigned iPile = 0; iPile<TableauSize; ++iPile) {
+        for (unsigned icd = iPile; icd < TableauSize; ++icd)
+            _tableau[icd].push_back(*iDeck++);
+        _downCount[iPile] = iPile;
+        _kingSpaces += _tableau[iPile][0].Rank() == Card::King;
+    }
+    _waste.clear();
+    _stock.assign(_deck.crbegin(), _deck.crbegin()+24);
+    _foundationSize.fill(0);
+
+    _pileSet.fill(0);
+    _faceUp = _tips = 0;
+    for (unsigned iTab = 0; iTab < TableauSize; ++iTab) {
+        const auto& pile = _tableau[iTab];
+        for (Card card: pile) {
+            _location[card.Value()] = TableauCode(iTab);
+            _pileSet[TableauCode(iTab)] |= CardBit(card);
+        }
+        _faceUp |= CardBit(pile.back());
+        _tips |= CardBit(pile.back());
+    }
+    for (Card card: _stock) {
+        _location[card.Value()] = Stock;
+        _pileSet[Stock] |= CardBit(card);
+    }
+    _foundationNext = RankSet(Card::Ace);
+}
+
+Card BitGame::PopCard(PileCodeT pile) noexcept
+{
+    Card card;
+    if (IsTableau(pile)) {
+        auto& cards = _tableau[TableauIndex(pile)];
+        card = cards.back();
+        cards.pop_back();
+        _faceUp &= ~CardBit(card);
+        _tips &= ~CardBit(card);
+        if (cards.size()) _tips |= CardBit(cards.back());
+    } else if (pile == Waste || pile == Stock) {
+        auto& cards = (pile == Waste) ? _waste : _stock;
+        card = cards.back();
+        cards.pop_back();
+    } else {
+        const unsigned suit = pile-FoundationBase;
+        const unsigned rank = --_foundationSize[suit];
+        card = Card(Card::SuitT(suit), Card::RankT(rank));
+        _foundationNext = (_foundationNext & ~SuitSet(suit)) | CardBit(card);
+    }
+    _pileSet[pile] &= ~CardBit(card);
+    return card;
+}
+
+void BitGame::PushCard(PileCodeT pile, Card card) noexcept
+{
+    if (IsTableau(pile)) {
+        auto& cards = _tableau[TableauIndex(pile)];
+        if (cards.size()) _tips &= ~CardBit(cards.back());
+        cards.push_back(card);
+        _faceUp |= CardBit(card);
+        _tips |= CardBit(card);
+    } else if (pile == Waste || pile == Stock) {
+        auto& cards = (pile == Waste) ? _waste : _stock;
+        cards.push_back(card);
+    } else {
+        const unsigned suit = pile-FoundationBase;
+        assert(card.Suit() == suit && card.Rank() == _foundationSize[suit]);
+        const unsigned rank = ++_foundationSize[suit];
+        _foundationNext &= ~SuitSet(suit);
+        if (rank < CardsPerSuit)
+            _foundationNext |= CardBit(Card(Card::SuitT(suit), Card::RankT(rank)));
+    }
+    _location[card.Value()] = pile;
+    _pileSet[pile] |= CardBit(card);
+}
+
+void BitGame::Take(PileCodeT to, PileCodeT from, unsigned n) noexcept
+{
+    static_vector<Card,24> moving;
+    for (unsigned i = 0; i < n; ++i) moving.push_back(PopCard(from));
+    for (Card card: views::reverse(moving)) PushCard(to, card);
+}
+
+void BitGame::SetDownCount(unsigned iTab, unsigned down) noexcept
+{
+    const auto& cards = _tableau[iTab];
+    for (unsigned i = down; i < _downCount[iTab]; ++i)
+        _faceUp |= CardBit(cards[i]);
+    for (unsigned i = _downCount[iTab]; i < down; ++i)
+        _faceUp &= ~CardBit(cards[i]);
+    _downCount[iTab] = down;
+}
+
+void BitGame::MakeMove(MoveSpec mv) noexcept
+{
+    const auto to = mv.To();
+    if (mv.IsStockMove()) {
+        for (int n = mv.DrawCount(); n > 0; --n) PushCard(Waste, PopCard(Stock));
+        for (int n = mv.DrawCount(); n < 0; ++n) PushCard(Stock, PopCard(Waste));
+        PushCard(to, PopCard(Waste));
+        _recycleCount += mv.Recycle();
+    } else {
+        const auto from = mv.From();
+        if (mv.FlipsTopCard()) {
+            assert(IsTableau(from));
+            const unsigned iFrom = TableauIndex(from);
+            SetDownCount(iFrom, _downCount[iFrom]-1);
+        }
+        Take(to, from, mv.NCards());
+        if (mv.IsLadderMove()) {
+            PushCard(mv.LadderPileCode(), PopCard(from));
+        }
+        _kingSpaces += IsTableau(from) && _pileSet[from] == 0;
+    }
+}
+
+void BitGame::UnMakeMove(MoveSpec mv) noexcept
+{
+    const auto to = mv.To();
+    if (mv.IsStockMove()) {
+        _recycleCount -= mv.Recycle();
+        PushCard(Waste, PopCard(to));
+        for (int n = mv.DrawCount(); n > 0; --n) PushCard(Stock, PopCard(Waste));
+        for (int n = mv.DrawCount(); n < 0; ++n) PushCard(Waste, PopCard(Stock));
+    } else {
+        const auto from = mv.From();
+        _kingSpaces -= IsTableau(from) && _pileSet[from] == 0;
+        if (mv.IsLadderMove()) {
+            PushCard(from, PopCard(mv.LadderPileCode()));
+        }
+        Take(from, to, mv.NCards());
+        if (mv.FlipsTopCard()) {
+            const unsigned iFrom = TableauIndex(from);
+            SetDownCount(iFrom, _downCount[iFrom]+1);
+        }
+    }
+}
+
+PileVec BitGame::Cards(PileCodeT pile) const noexcept
+{
+    if (IsTableau(pile)) {
+        const auto& cards = _tableau[TableauIndex(pile)];
+        return PileVec(cards.begin(), cards.end());
+    } else if (pile == Waste) {
+        return _waste;
+    } else if (pile == Stock) {
+        return _stock;
+    } else {
+        const unsigned suit = pile-FoundationBase;
+        PileVec result;
+        for (unsigned rank = 0; rank < _foundationSize[suit]; ++rank)
+            result.emplace_back(Card::SuitT(suit), Card::RankT(rank));
+        return result;
+    }
+}
+
+PileCodeT BitGame::FirstEmptyTableau() const noexcept
+{
+    for (unsigned iTab = 0; iTab < TableauSize; ++iTab) {
+        if (_tableau[iTab].empty()) return TableauCode(iTab);
+    }
+    return PileCount;
+}
+
+unsigned BitGame::MaxDominantMoveRank() const noexcept
+{
+    return *ranges::min_element(_foundationSize) + 1;
+}
+
+// Same moves in the same order as Game::DominantAvailableMoves()
+void BitGame::DominantAvailableMoves(MoveCacheType& moves) const noexcept
+{
+    // The ranks up to MaxDominantMoveRank() in every suit
+    const unsigned maxRank = std::min<unsigned>(MaxDominantMoveRank(), Card::King);
+    const CardSet dominant = _foundationNext
+        & ((CardSet{2} << maxRank) - 1) * RankSet(Card::Ace);
+    if (_drawSetting == 1 && _waste.size() && (dominant & CardBit(_waste.back()))) {
+        moves.AddNonStockMove(Waste, FoundationPileCode(_waste.back().Suit()), 1, false);
+    }
+    if (dominant & _tips) {
+        for (unsigned iTab = 0; iTab < TableauSize; ++iTab) {
+            const auto& pile = _tableau[iTab];
+            if (pile.size() && (dominant & CardBit(pile.back()))) {
+                moves.AddNonStockMove(TableauCode(iTab), FoundationPileCode(pile.back().Suit()), 1,
+                    UpCount(iTab) == 1 && _downCount[iTab]);
+            }
+        }
+    }
+    if (_drawSetting == 1 && _stock.size() && (dominant & CardBit(_stock.back()))) {
+        moves.AddStockMove(FoundationPileCode(_stock.back().Suit()), 2, 1, false);
+    }
+}
+
+void BitGame::MovesFromTableau(QMoves& moves) const noexcept
+{
+    // Moves to the foundation
+    ForEachCard(_tips & _foundationNext, [&](Card card) {
+        const PileCodeT from = _location[card.Value()];
+        const unsigned iFrom = TableauIndex(from);
+        moves.AddNonStockMove(from, FoundationPileCode(card.Suit()), 1,
+            UpCount(iFrom) == 1 && _downCount[iFrom]);
+    });
+
+    // Moves onto the last card of another tableau pile.  Those
+    // are the face-up cards of the next lower rank and the other
+    // color.  As in Game::MovesFromTableau(), the move must either
+    // move all the face-up cards, flipping a card or clearing a
+    // column a king needs, or uncover a card that can go to the
+    // foundation.
+    ForEachCard(_tips, [&](Card target) {
+        const PileCodeT to = _location[target.Value()];
+        ForEachCard(CoverSet(target) & _faceUp, [&](Card mover) {
+            const PileCodeT from = _location[mover.Value()];
+            const unsigned iFrom = TableauIndex(from);
+            const auto& fromPile = _tableau[iFrom];
+            const unsigned upCount = UpCount(iFrom);
+            const unsigned downCount = _downCount[iFrom];
+            const unsigned moveCount = mover.Rank() - fromPile.back().Rank() + 1;
+            assert(moveCount <= upCount);
+            if (moveCount == upCount) {
+                if (downCount || NeedKingSpace())
+                    moves.AddNonStockMove(from, to, upCount, downCount);
+            } else {
+                const Card uncovered = *(fromPile.end()-moveCount-1);
+                if (CanMoveToFoundation(uncovered)) {
+                    moves.AddLadderMove(from, to, moveCount, uncovered,
+                        upCount == moveCount+1 && downCount);
+                }
+            }
+        });
+    });
+
+    // Moves of a king and the cards on it to an empty column.  A
+    // face-up king is always the lowest face-up card in its pile.
+    const PileCodeT empty = FirstEmptyTableau();
+    if (empty != PileCount) {
+        ForEachCard(_faceUp & RankSet(Card::King), [&](Card king) {
+            const PileCodeT from = _location[king.Value()];
+            const unsigned iFrom = TableauIndex(from);
+            if (_downCount[iFrom])
+                moves.AddNonStockMove(from, empty, UpCount(iFrom), true);
+        });
+    }
+}
+
+void BitGame::MovesFromTalon(QMoves& moves) const noexcept
+{
+    const unsigned maxDominantRank = MaxDominantMoveRank();
+    const PileCodeT empty = FirstEmptyTableau();
+    for (auto talonCard : TalonCards(*this)) {
+        const Card card = talonCard._card;
+        const unsigned nMoves = talonCard._nMoves+1;
+        const int draw = talonCard._drawCount;
+        const bool recycle = talonCard._recycle;
+        if (CanMoveToFoundation(card)) {
+            moves.AddStockMove(FoundationPileCode(card.Suit()), nMoves, draw, recycle);
+            if (card.Rank() <= maxDominantRank) {
+                if (_drawSetting == 1)
+                    break;
+                else
+                    continue;
+            }
+        }
+        ForEachCard(CoveredSet(card) & _tips, [&](Card target) {
+            moves.AddStockMove(_location[target.Value()], nMoves, draw, recycle);
+        });
+        if (card.Rank() == Card::King && empty != PileCount) {
+            moves.AddStockMove(empty, nMoves, draw, recycle);
+        }
+    }
+}
+
+void BitGame::MovesFromFoundation(QMoves& moves) const noexcept
+{
+    const unsigned maxDominantRank = MaxDominantMoveRank();
+    const PileCodeT empty = FirstEmptyTableau();
+    for (unsigned suit = 0; suit < SuitsPerDeck; ++suit) {
+        // Avoid generating moves whose reversals are dominant.
+        const unsigned size = _foundationSize[suit];
+        if (size <= maxDominantRank + 1) continue;
+        const PileCodeT from = FoundationPileCode(Card::SuitT(suit));
+        const Card top(Card::SuitT(suit), Card::RankT(size-1));
+        ForEachCard(CoveredSet(top) & _tips, [&](Card target) {
+            moves.AddNonStockMove(from, _location[target.Value()], 1, false);
+        });
+        if (top.Rank() == Card::King && empty != PileCount) {
+            moves.AddNonStockMove(from, empty, 1, false);
+        }
+    }
+}
+}   // namespace KSolveNames
@@ -0,0 +1,177 @@
+// BitGame.hpp declares BitGame, a compact alternative to Game.
+//
+// BitGame keeps sets of cards in 64-bit masks, one bit per card value.
+// Alongside the cards in each pile, it keeps a table giving the pile
+// each card is in, a mask of the face-up tableau cards, a mask of the
+// last card on each tableau pile, and a mask of the card each
+// foundation pile needs next.  With masks of the cards of each rank
+// and color, finding the moves between tableau piles and to the
+// foundation becomes a matter of intersecting sets rather than
+// comparing piles card by card.
+//
+// It follows Game's contract for Deal(), AvailableMoves(), MakeMove()
+// and UnMakeMove(): given the same deal and the same moves, it
+// generates the same MoveSpecs.  unittests and movegen-check check that.
+//
+// It is a prototype.  The solver does not use it yet: KSolveAStar(),
+// GameState and MinimumMovesLeft() take a Game, and BitGame keeps
+// neither a state key nor the heuristic's counts.  Only the tests and
+// perft -b run it, to compare its move generator's speed and results
+// with Game's.
+
+#ifndef BITGAME_HPP
+#define BITGAME_HPP
+
+#include "Game.hpp"
+#include <bit>          // countr_zero
+
+namespace KSolveNames {
+
+using CardSet = uint64_t;
+static_assert(CardsPerDeck <= 64);
+
+inline CardSet CardBit(Card card) noexcept
+{
+    return CardSet{1} << card.Value();
+}
+// The set of cards in suit
+constexpr CardSet SuitSet(unsigned suit) noexcept
+{
+    return ((CardSet{1} << CardsPerSuit) - 1) << (suit*CardsPerSuit);
+}
+// The set of cards of rank
+constexpr CardSet RankSet(unsigned rank) noexcept
+{
+    CardSet result{0};
+    for (unsigned suit = 0; suit < SuitsPerDeck; ++suit)
+        result |= CardSet{1} << (suit*CardsPerSuit+rank);
+    return result;
+}
+constexpr CardSet RedSet{SuitSet(Card::Diamonds)|SuitSet(Card::Hearts)};
+constexpr CardSet BlackSet{SuitSet(Card::Clubs)|SuitSet(Card::Spades)};
+
+// The set of cards that can be moved onto card in the tableau
+inline CardSet CoverSet(Card card) noexcept
+{
+    if (card.Rank() == Card::Ace) return 0;
+    return RankSet(card.Rank()-1) & ((card.Suit()&1) ? BlackSet : RedSet);
+}
+// The set of cards onto which card can be moved in the tableau
+inline CardSet CoveredSet(Card card) noexcept
+{
+    if (card.Rank() == Card::King) return 0;
+    return RankSet(card.Rank()+1) & ((card.Suit()&1) ? BlackSet : RedSet);
+}
+
+// Call f(card) for each card in set, lowest value first
+template <class Func>
+void ForEachCard(CardSet set, Func f)
+{
+    for (; set; set &= set-1)
+        f(Card(unsigned(std::countr_zero(set))));
+}
+
+class BitGame
+{
+    // A tableau pile can hold six face-down cards and thirteen face-up
+    using TableauPile = static_vector<Card,19>;
+
+    std::array<PileCodeT,CardsPerDeck> _location;   // pile each card is in
+    std::array<CardSet,PileCount> _pileSet;         // cards in each pile
+    CardSet         _faceUp{0};         // face-up cards in the tableau
+    CardSet         _tips{0};           // last card on each nonempty tableau pile
+    CardSet         _foundationNext{0}; // card each foundation pile needs next
+
+    std::array<TableauPile,TableauSize> _tableau;
+    std::array<unsigned char,TableauSize> _downCount;
+    PileVec         _waste;
+    PileVec         _stock;
+    std::array<unsigned char,SuitsPerDeck> _foundationSize;
+
+    unsigned char   _drawSetting;
+    unsigned char   _recycleLimit;
+    unsigned char   _recycleCount;
+    unsigned char   _kingSpaces;        // as in Game
+
+    const CardDeck _deck;
+    using MoveCacheType = QMovesTemplate<9>;
+    MoveCacheType _domMovesCache;
+
+    static unsigned TableauIndex(PileCodeT pile) noexcept {return pile-TableauBase;}
+    static PileCodeT TableauCode(unsigned index) noexcept {return PileCodeT(TableauBase+index);}
+
+    unsigned UpCount(unsigned iTab) const noexcept
+                                {return _tableau[iTab].size()-_downCount[iTab];}
+    bool NeedKingSpace() const noexcept {return _kingSpaces < SuitsPerDeck;}
+    bool CanMoveToFoundation(Card card) const noexcept
+                                {return _foundationNext & CardBit(card);}
+    // The first empty tableau pile, or PileCount if none is empty
+    PileCodeT FirstEmptyTableau() const noexcept;
+    // Like Game::DominantMoveTester
+    unsigned MaxDominantMoveRank() const noexcept;
+
+    Card PopCard(PileCodeT pile) noexcept;
+    void PushCard(PileCodeT pile, Card card) noexcept;
+    // Move the last n cards on from to to, preserving their order
+    void Take(PileCodeT to, PileCodeT from, unsigned n) noexcept;
+    void SetDownCount(unsigned iTab, unsigned down) noexcept;
+
+    void DominantAvailableMoves(MoveCacheType& moves) const noexcept;
+    void MovesFromTableau(QMoves& moves) const noexcept;
+    void MovesFromTalon(QMoves& moves) const noexcept;
+    void MovesFromFoundation(QMoves& moves) const noexcept;
+
+public:
+    BitGame(CardDeck deck,
+            unsigned draw=1,
+            unsigned recycleLimit=-1);
+    const PileVec& WastePile() const noexcept       {return _waste;}
+    const PileVec& StockPile() const noexcept       {return _stock;}
+    unsigned DrawSetting() const noexcept           {return _drawSetting;}
+    unsigned RecycleLimit() const noexcept          {return _recycleLimit;}
+    unsigned RecycleCount() const noexcept          {return _recycleCount;}
+    // BitGame always looks at every talon card
+    unsigned TalonLookAhead() const noexcept        {return MaxTalonLookAhead;}
+    // The cards in a pile, bottom first, and for a tableau pile, how
+    // many are face up.  For comparing with a Game.
+    PileVec Cards(PileCodeT pile) const noexcept;
+    unsigned UpCount(PileCodeT pile) const noexcept {return UpCount(TableauIndex(pile));}
+
+    void Deal() noexcept;
+    void MakeMove(MoveSpec mv) noexcept;
+    void UnMakeMove(MoveSpec mv) noexcept;
+    bool GameOver() const noexcept
+    {
+        return ranges::all_of(_foundationSize,
+            [](unsigned size) {return size == CardsPerSuit;});
+    }
+
+    // Same as Game::ClearMoveCache()
+    void ClearMoveCache() noexcept                  {_domMovesCache.clear();}
+    // Same as Game::AvailableMoves()
+    template <class V>
+    QMoves AvailableMoves(const V& movesMade) noexcept
+    {
+        QMoves avail;
+        if (GameOver()) return avail;
+
+        if (_domMovesCache.empty()) {
+            DominantAvailableMoves(_domMovesCache);
+            XYZ_Filter(_domMovesCache, movesMade);
+        }
+        if (_domMovesCache.size()) {
+            avail.push_back(_domMovesCache.back());
+            _domMovesCache.pop_back();
+            return avail;
+        }
+
+        MovesFromTableau(avail);
+        MovesFromTalon(avail);
+        MovesFromFoundation(avail);
+        XYZ_Filter(avail, movesMade);
+        return avail;
+    }
+};
+}   // namespace KSolveNames
+
+#endif      // BITGAME_HPP
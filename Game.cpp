@@ -3,8 +3,11 @@
 */
 
 #include "Game.hpp"
+#include "Talon.hpp"
+#include "Kernels.hpp"
 #include <cassert>
 #include <algorithm>		// swap
+#include <bit>			// countr_zero, popcount
 #include <random>
 
 const std::string suits("cdsh");
@@ -119,13 +122,103 @@ Game::Game(CardDeck deck,unsigned draw,unsigned recycleLimit)
     , _recycleLimit(recycleLimit)
     , _tableau{Tableau1,Tableau2,Tableau3,Tableau4,Tableau5,Tableau6,Tableau7}
     , _foundation{Foundation1C,Foundation2D,Foundation3S,Foundation4H}
+    , _kernels(&BestKernels())
 {
     Deal();
+    BuildCrossPileGraph();
 }
 
-// Deal the cards for Klondike Solitaire.
+// Return the snapshot Restore() needs to set up position
+static GameSnapshot Snapshot(const GamePosition& position) noexcept
+{
+    GameSnapshot result;
+    auto out = ranges::copy(position._waste, result._cards.begin()).out;
+    result._wasteSize = position._waste.size();
+    result._kingSpaces = 0;
+    for (unsigned i = 0; i < TableauSize; ++i) {
+        const PileVec& pile = position._tableau[i];
+        out = ranges::copy(pile, out).out;
+        result._tableau[i] = pile.size() | position._downCount[i]<<5;
+        result._kingSpaces += pile.empty() || pile[0].Rank() == Card::King;
+    }
+    ranges::copy(position._stock, out);
+    result._foundationSizes = 0;
+    for (unsigned suit = 0; suit < SuitsPerDeck; ++suit) {
+        result._foundationSizes |= position._foundationSizes[suit] << 4*suit;
+    }
+    result._recycleCount = position._recycleCount;
+    return result;
+}
+
+Game::Game(const GamePosition& position,unsigned draw,unsigned recycleLimit)
+    : _deck()
+    , _waste(Waste)
+    , _stock(Stock)
+    , _drawSetting(draw)
+    , _recycleLimit(recycleLimit)
+    , _tableau{Tableau1,Tableau2,Tableau3,Tableau4,Tableau5,Tableau6,Tableau7}
+    , _foundation{Foundation1C,Foundation2D,Foundation3S,Foundation4H}
+    , _startPosition(Snapshot(position))
+    , _kernels(&BestKernels())
+{
+    assert(PositionError(position).empty());
+    assert(position._recycleCount <= _recycleLimit);
+    Deal();
+    BuildCrossPileGraph();
+}
+
+std::string PositionError(const GamePosition& position)
+{
+    std::array<bool,CardsPerDeck> seen{};
+    std::string duplicate;
+    auto See = [&](Card card) {
+        if (seen[card.Value()] && duplicate.empty()) duplicate = card.AsString();
+        seen[card.Value()] = true;
+    };
+    for (unsigned suit = 0; suit < SuitsPerDeck; ++suit) {
+        if (position._foundationSizes[suit] > CardsPerSuit) 
+            return "A foundation pile holds more than 13 cards";
+        for (unsigned rank = 0; rank < position._foundationSizes[suit]; ++rank)
+            See(Card(Card::SuitT(suit), Card::RankT(rank)));
+    }
+    if (position._recycleCount >= UCHAR_MAX)
+        return "The recycle count is too large";
+    ranges::for_each(position._waste, See);
+    ranges::for_each(position._stock, See);
+    if (position._waste.size() + position._stock.size() > 24)
+        return "The stock and waste piles hold more than 24 cards";
+    for (unsigned i = 0; i < TableauSize; ++i) {
+        const PileVec& pile = position._tableau[i];
+        const unsigned down = position._downCount[i];
+        const std::string name = "Tableau pile " + std::to_string(i+1);
+        ranges::for_each(pile, See);
+        if (down > i) 
+            return name + " has more face-down cards than were dealt to it";
+        if (pile.size() && down >= pile.size()) 
+            return name + " has no face-up card";
+        if (pile.size() > down+12)
+            return name + " has more than 12 face-up cards";
+        for (unsigned j = down+1; j < pile.size(); ++j) {
+            if (!pile[j].Covers(pile[j-1]))
+                return name + "'s face-up cards are out of sequence";
+        }
+    }
+    if (duplicate.size()) 
+        return "The " + duplicate + " appears twice";
+    for (unsigned c = 0; c < CardsPerDeck; ++c) {
+        if (!seen[c]) return "The " + Card(c).AsString() + " is missing";
+    }
+    return std::string();
+}
+
+// Deal the cards for Klondike Solitaire, or return to the
+// position the game started from.
 void Game::Deal() noexcept
 {
+    if (_startPosition) {
+        Restore(*_startPosition);
+        return;
+    }
     assert(_deck.size() == CardsPerDeck);
     _kingSpaces = 0;
     _recycleCount = 0;
@@ -143,6 +236,322 @@ void Game::Deal() noexcept
     }
     // Deal last 24 cards to stock, reversing order
     _stock.assign(_deck.crbegin(), _deck.crbegin()+24);
+    ResetTableauCodes();
+    ResetMisorders();
+}
+
+// All the cards in order of Value(), so each suit's cards are in 
+// the order they go to its foundation pile
+static const CardDeck SortedDeck = [] {
+    CardDeck deck(CardsPerDeck);
+    std::iota(deck.begin(), deck.end(), 0);
+    return deck;
+}();
+
+GameSnapshot Game::Save() const noexcept
+{
+    GameSnapshot result;
+    auto out = result._cards.begin();
+    for (const Pile& pile: AllPiles() | views::take(Stock+1)) {
+        out = ranges::copy(pile, out).out;
+    }
+    result._wasteSize = _waste.size();
+    for (unsigned i = 0; i < TableauSize; ++i) {
+        const Pile& pile = _tableau[i];
+        result._tableau[i] = pile.size() | pile.DownCount()<<5;
+    }
+    result._foundationSizes = 0;
+    for (unsigned suit = 0; suit < SuitsPerDeck; ++suit) {
+        result._foundationSizes |= _foundation[suit].size() << 4*suit;
+    }
+    result._recycleCount = _recycleCount;
+    result._kingSpaces = _kingSpaces;
+    return result;
+}
+
+void Game::Restore(const GameSnapshot& snapshot) noexcept
+{
+    unsigned onFoundation = 0;
+    for (unsigned suit = 0; suit < SuitsPerDeck; ++suit) {
+        const unsigned size = snapshot._foundationSizes >> 4*suit & 15;
+        const auto first = SortedDeck.begin() + suit*CardsPerSuit;
+        _foundation[suit].assign(first, first+size);
+        onFoundation += size;
+    }
+    auto in = snapshot._cards.begin();
+    _waste.assign(in, in+snapshot._wasteSize);
+    in += snapshot._wasteSize;
+    for (unsigned i = 0; i < TableauSize; ++i) {
+        const unsigned size = snapshot._tableau[i] & 31;
+        _tableau[i].assign(in, in+size);
+        _tableau[i].SetDownCount(snapshot._tableau[i] >> 5);
+        in += size;
+    }
+    _stock.assign(in, snapshot._cards.begin() + (CardsPerDeck-onFoundation));
+    _recycleCount = snapshot._recycleCount;
+    _kingSpaces = snapshot._kingSpaces;
+    _domMovesCache.clear();
+    ResetTableauCodes();
+    ResetMisorders();
+}
+
+uint32_t Game::TableauCode(const Pile& cards) const noexcept
+{
+    uint32_t result {0};
+    if (cards.size()) {
+        // The face-up cards in a tableau pile cannot number
+        // more than 12, since AvailableMoves() will never move an
+        // ace there.
+        const unsigned first = cards.DownCount()+1;
+        const unsigned isMajor = _kernels->_majorSuitBits(cards, first, cards.size()-first);
+        const Card top = cards.Top();
+        result =  ((top.Suit()
+                    <<4  | top.Rank())
+                    <<11 | isMajor)
+                    <<4  | cards.UpCount();
+    }
+    return result;
+}
+
+// Return the code for a tableau pile after card is pushed onto it
+static uint32_t PushTableauCode(uint32_t code, Card card) noexcept
+{
+    const unsigned upCount = code & 0xf;
+    if (upCount == 0) {
+        return ((card.Suit()<<4 | card.Rank())<<11)<<4 | 1;
+    }
+    const unsigned isMajor = (code>>4 & 0x7ff)<<1 | card.IsMajor();
+    return (code & ~0x7fffU) | isMajor<<4 | (upCount+1);
+}
+
+// Return the code for a tableau pile after its top n cards are
+// removed, assuming that does not leave it with face-down cards only.
+static uint32_t PopTableauCode(uint32_t code, unsigned n) noexcept
+{
+    const unsigned upCount = code & 0xf;
+    assert(n <= upCount);
+    if (n == upCount) return 0;
+    const unsigned isMajor = (code>>4 & 0x7ff)>>n;
+    return (code & ~0x7fffU) | isMajor<<4 | (upCount-n);
+}
+
+void Game::SetTableauCode(const Pile& pile, uint32_t code) noexcept
+{
+    uint32_t& oldCode = _tableauCodes[pile.Code()-TableauBase];
+    _tableauHash += MixBits(code) - MixBits(oldCode);
+    oldCode = code;
+    assert(code == TableauCode(pile));
+}
+
+void Game::ResetTableauCodes() noexcept
+{
+    _tableauHash = 0;
+    for (unsigned i = 0; i < TableauSize; ++i) {
+        _tableauCodes[i] = TableauCode(_tableau[i]);
+        _tableauHash += MixBits(_tableauCodes[i]);
+    }
+}
+
+void Game::SetTableauMisorders(const Pile& pile) noexcept
+{
+    unsigned char& oldCount = _tableauMisorders[pile.Code()-TableauBase];
+    const unsigned count = pile.size() ? _kernels->_misorderCount(pile, pile.DownCount()+1) : 0;
+    _tableauMisorderSum += count - oldCount;
+    oldCount = count;
+}
+
+// The size of the smallest set of the vertices in live that holds a
+// vertex of each cycle among them.  out[v] is the set of vertices v has
+// an edge to, and in[v] the set with an edge to v.
+static unsigned MinFeedbackVertexSet(std::array<uint32_t,32> out, 
+    std::array<uint32_t,32> in, uint32_t live) noexcept
+{
+    // Take v out of the graph, keeping the cycles that ran through it
+    auto Bypass = [&](unsigned v) {
+        live &= ~(1U << v);
+        const uint32_t succ = out[v] & live, pred = in[v] & live;
+        for (uint32_t rest = pred; rest; rest &= rest-1)
+            out[std::countr_zero(rest)] |= succ;
+        for (uint32_t rest = succ; rest; rest &= rest-1)
+            in[std::countr_zero(rest)] |= pred;
+    };
+    unsigned result = 0;
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (uint32_t rest = live; rest; rest &= rest-1) {
+            const unsigned v = std::countr_zero(rest);
+            const uint32_t bit = 1U << v;
+            if (!(live & bit)) continue;
+            const uint32_t succ = out[v] & live, pred = in[v] & live;
+            if (succ & bit) {
+                // A cycle by itself
+                live &= ~bit;
+                result += 1;
+            } else if (!succ || !pred) {
+                // On no cycle
+                live &= ~bit;
+            } else if (std::popcount(succ) == 1 || std::popcount(pred) == 1) {
+                // Every cycle through v also runs through its one 
+                // neighbor on that side, which can stand in for it.
+                Bypass(v);
+            } else {
+                continue;
+            }
+            changed = true;
+        }
+    }
+    if (!live) return result;
+    // Either the vertex likely on the most cycles is in the set or it
+    // can be bypassed.
+    unsigned v = 0, most = 0;
+    for (uint32_t rest = live; rest; rest &= rest-1) {
+        const unsigned u = std::countr_zero(rest);
+        const unsigned paths = std::popcount(in[u] & live) * std::popcount(out[u] & live);
+        if (paths > most) {
+            v = u;
+            most = paths;
+        }
+    }
+    const unsigned taken = 1 + MinFeedbackVertexSet(out, in, live & ~(1U << v));
+    Bypass(v);
+    return result + std::min(taken, MinFeedbackVertexSet(out, in, live));
+}
+
+// Each card not on a foundation pile must move at least once.  Say a
+// card X waits for a card Z if Z lies above a lower card of X's suit, so
+// that Z must leave its place before X can go to its foundation pile.
+// Look only at the face-down cards and the first face-up card of each
+// tableau pile, which can leave their places only one at a time.  If
+// such cards wait for each other in a cycle, they cannot all go straight
+// to their foundation piles: one must first move to another tableau pile
+// as the bottom card of the cards moved.  That is one more move for that
+// card.  So the cards that must make such moves hold one card of each
+// cycle, and there are at least as many as the smallest such set has.
+// A card that waits for itself makes such a move anyway, and 
+// TableauMisorders() counts it, so it is left out.
+//
+// Only a flip, or a move that empties a pile, takes a card out of this
+// graph, and a card moved to an empty pile lies above nothing, so no
+// move adds an edge.  Taking one card out of a graph shrinks that set by
+// one at most, and a card that goes to its foundation pile waits for no
+// other card and so is on no cycle.  The count drops by one at most with
+// each move, and only with a move that is not to a foundation pile.
+Game::CrossPileGraph Game::MakeCrossPileGraph(const TableauType& tableau) noexcept
+{
+    std::array<Card,32> cards;
+    std::array<CardMask,32> below;
+    std::array<unsigned char,32> pileOf, indexOf;
+    unsigned n = 0;
+    for (unsigned p = 0; p < TableauSize; ++p) {
+        const Pile& pile = tableau[p];
+        CardMask under = 0;
+        for (unsigned i = 0; i < pile.size() && i <= pile.DownCount(); ++i) {
+            const Card card = pile[i];
+            if (under && !(under & LowerCards(card))) {
+                cards[n] = card;
+                below[n] = under;
+                pileOf[n] = p;
+                indexOf[n] = i;
+                n += 1;
+            }
+            under |= CardMask{1} << card.Value();
+        }
+    }
+    CrossPileGraph result{};
+    for (unsigned i = 0; i < n; ++i) {
+        for (unsigned j = 0; j < n; ++j) {
+            if (i != j && (below[j] & LowerCards(cards[i]))) {
+                result._waitsFor[i] |= 1U << j;
+                result._waitedFor[j] |= 1U << i;
+            }
+        }
+    }
+    for (unsigned i = 0; i < n; ++i) {
+        if (!(result._waitsFor[i] | result._waitedFor[i])) continue;
+        for (unsigned d = indexOf[i]; d < TableauSize; ++d) {
+            result._vertices[pileOf[i]][d] |= 1U << i;
+        }
+    }
+    return result;
+}
+
+unsigned Game::CrossPileBlocks(const TableauType& tableau) noexcept
+{
+    const CrossPileGraph graph = MakeCrossPileGraph(tableau);
+    uint32_t live = 0;
+    for (const auto& pileVertices: graph._vertices) live |= pileVertices.back();
+    return MinFeedbackVertexSet(graph._waitsFor, graph._waitedFor, live);
+}
+
+void Game::BuildCrossPileGraph() noexcept
+{
+    _crossPileGraph = MakeCrossPileGraph(_tableau);
+    _crossPileCosts = nullptr;
+    SetCrossPileBlocks();
+}
+
+Game::CrossPileCosts Game::MakeCrossPileCosts() const noexcept
+{
+    // Index the face-down counts, from 0 to p in pile p, as a 
+    // mixed-radix number, as SetCrossPileBlocks() does.  An empty
+    // pile's count is 0, and no card at index 0 is in the graph.
+    CrossPileCosts result;
+    for (unsigned index = 0; index < result.size(); ++index) {
+        uint32_t live = 0;
+        for (unsigned p = 0, rest = index; p < TableauSize; rest /= p+1, ++p) {
+            live |= _crossPileGraph._vertices[p][rest % (p+1)];
+        }
+        result[index] = MinFeedbackVertexSet(_crossPileGraph._waitsFor, 
+                                             _crossPileGraph._waitedFor, live);
+    }
+    return result;
+}
+
+void Game::UseCrossPileCosts(const CrossPileCosts* costs) noexcept
+{
+    _crossPileCosts = costs;
+    [[maybe_unused]] const unsigned blocks = _crossPileBlocks;
+    SetCrossPileBlocks();
+    assert(_crossPileBlocks == blocks);
+}
+
+void Game::SetCrossPileBlocks() noexcept
+{
+    if (_crossPileCosts) {
+        unsigned index = 0;
+        unsigned weight = 1;
+        for (unsigned p = 0; p < TableauSize; ++p) {
+            const Pile& pile = _tableau[p];
+            index += (pile.size() ? pile.DownCount() : 0) * weight;
+            weight *= p+1;
+        }
+        _crossPileBlocks = (*_crossPileCosts)[index];
+    } else {
+        uint32_t live = 0;
+        for (const Pile& pile: _tableau) {
+            if (pile.size()) 
+                live |= _crossPileGraph._vertices[pile.Code()-TableauBase][pile.DownCount()];
+        }
+        _crossPileBlocks = MinFeedbackVertexSet(_crossPileGraph._waitsFor, 
+                                                _crossPileGraph._waitedFor, live);
+    }
+}
+
+void Game::ResetMisorders() noexcept
+{
+    _tableauMisorders.fill(0);
+    _tableauMisorderSum = 0;
+    for (const Pile& pile: _tableau) {
+        SetTableauMisorders(pile);
+    }
+    SetCrossPileBlocks();
+    _wasteMisordersValid = false;
+}
+
+void Game::CountWasteMisorders() const noexcept
+{
+    _wasteMisorders = _kernels->_misorderCount(_waste, _waste.size());
+    _wasteMisordersValid = true;
 }
 
 void Game::MakeMove(MoveSpec mv) noexcept
@@ -153,6 +562,10 @@ void Game::MakeMove(MoveSpec mv) noexcept
         _waste.Draw(_stock,mv.DrawCount());
         toPile.Push(_waste.Pop());
         _recycleCount += mv.Recycle();
+        _wasteMisordersValid = false;
+        if (toPile.IsTableau()) {
+            SetTableauCode(toPile, PushTableauCode(_tableauCodes[to-TableauBase], toPile.back()));
+        }
     } else {
         const auto  n = mv.NCards();
         Pile&       fromPile = AllPiles()[mv.From()];
@@ -167,6 +580,25 @@ void Game::MakeMove(MoveSpec mv) noexcept
             _foundation[mv.LadderSuit()].Draw(fromPile);
         }
         _kingSpaces += fromPile.IsTableau() & fromPile.empty(); // count newly cleared columns
+        _wasteMisordersValid &= fromPile.Code() != Waste;
+        if (flips) {
+            SetTableauMisorders(fromPile);
+            SetCrossPileBlocks();
+        }
+
+        if (toPile.IsTableau()) {
+            uint32_t code = _tableauCodes[to-TableauBase];
+            for (Card card: toPile | views::drop(toPile.size()-n)) {
+                code = PushTableauCode(code, card);
+            }
+            SetTableauCode(toPile, code);
+        }
+        if (fromPile.IsTableau()) {
+            // A flip leaves only the flipped card face up
+            SetTableauCode(fromPile, flips
+                ? PushTableauCode(0, fromPile.back())
+                : PopTableauCode(_tableauCodes[mv.From()-TableauBase], n+isLadderMove));
+        }
     }
 }
 
@@ -178,6 +610,10 @@ void  Game::UnMakeMove(MoveSpec mv) noexcept
         _recycleCount -= mv.Recycle();
         _waste.Push(toPile.Pop());
         _stock.Draw(_waste,mv.DrawCount());
+        _wasteMisordersValid = false;
+        if (toPile.IsTableau()) {
+            SetTableauCode(toPile, PopTableauCode(_tableauCodes[to-TableauBase], 1));
+        }
     } else {
         const auto  n = mv.NCards();
         Pile&       fromPile = AllPiles()[mv.From()];
@@ -190,6 +626,23 @@ void  Game::UnMakeMove(MoveSpec mv) noexcept
         }
         fromPile.Take(toPile, n);
         fromPile.IncrDownCount(flips);
+        _wasteMisordersValid &= fromPile.Code() != Waste;
+        if (flips) {
+            SetTableauMisorders(fromPile);
+            SetCrossPileBlocks();
+        }
+
+        if (toPile.IsTableau()) {
+            SetTableauCode(toPile, PopTableauCode(_tableauCodes[to-TableauBase], n));
+        }
+        if (fromPile.IsTableau()) {
+            // Undoing a flip leaves only the returned cards face up
+            uint32_t code = flips ? 0 : _tableauCodes[mv.From()-TableauBase];
+            for (Card card: fromPile | views::drop(fromPile.size()-n-isLadderMove)) {
+                code = PushTableauCode(code, card);
+            }
+            SetTableauCode(fromPile, code);
+        }
     }
 }
 
@@ -210,6 +663,8 @@ void Game::MakeMove(const XMove & xmv) noexcept
     if (xmv.Flip()){
         fromPile.SetUpCount(1);    // flip the top card
     }
+    ResetTableauCodes();
+    ResetMisorders();
 }
 
 // Return true if all CardsPerDeck cards are in the foundation
@@ -219,6 +674,30 @@ bool Game::GameOver() const noexcept
         [] (const auto& pile) {return pile.size() == CardsPerSuit;});
 }
 
+bool Game::CanAutoComplete() const noexcept
+{
+    return _stock.empty() && _waste.empty()
+        && ranges::all_of(_tableau,
+            [] (const auto& pile) {return pile.DownCount() == 0;});
+}
+
+void Game::AutoComplete(Moves& moves) noexcept
+{
+    assert(CanAutoComplete());
+    // Each tableau pile is a run whose top card is its lowest, so the
+    // lowest card left is always on top of some pile.
+    while (!GameOver()) {
+        for (const Pile& pile: _tableau) {
+            if (pile.size() && CanMoveToFoundation(pile.back())) {
+                const MoveSpec mv(pile.Code(), 
+                    FoundationPileCode(pile.back().Suit()), 1, false);
+                MakeMove(mv);
+                moves.push_back(mv);
+            }
+        }
+    }
+}
+
 // Append all the dominant moves from the current position
 // to the *moves* vector.
 //
@@ -233,13 +712,15 @@ bool Game::GameOver() const noexcept
 // is "short" for this purpose if no other foundation pile
 // is more than one card shorter.
 // 
+template <class R>
 void Game::DominantAvailableMoves(
     MoveCacheType& moves, const DominantMoveTester& tester) const noexcept
 {
-    // Loop over Waste (if _drawSetting == 1), all Tableau piles
+    const unsigned draw = R::Draw ? R::Draw : _drawSetting;
+    // Loop over Waste (if draw == 1), all Tableau piles
     for (auto fromPile: AllPiles() 
             | views::take(Tableau7+1) 
-            | views::drop(Waste + (_drawSetting!=1))) {
+            | views::drop(Waste + (draw!=1))) {
         if (fromPile.size()) {
             const Card& card = fromPile.back();
             const auto fromCode = fromPile.Code();
@@ -252,7 +733,7 @@ void Game::DominantAvailableMoves(
             }
         }
     }
-    if (_drawSetting == 1 && _stock.size()) {
+    if (draw == 1 && _stock.size()) {
         const Card& card = _stock.back();
         if (tester.IsMoveDominant(card) && CanMoveToFoundation(card))  {
             // Stock MoveSpec: draw one card, move it to foundation
@@ -263,6 +744,7 @@ void Game::DominantAvailableMoves(
 }
 
 // Append to "moves" any available moves from tableau piles.
+template <class R>
 void Game::MovesFromTableau(QMoves & moves) const noexcept
 {
     for (const auto& fromPile: _tableau) {
@@ -280,6 +762,10 @@ void Game::MovesFromTableau(QMoves & moves) const noexcept
                 upCount == 1 && fromPile.DownCount());
         }
 
+        // Without PruneDominant, an ace can be left face up on the
+        // tableau.  It stays off other piles (see TableauCode()).
+        if (!R::Prunes(PruneDominant) && fromTip.Rank() == Card::Ace) continue;
+
         // Look for moves between tableau piles.  These may involve
         // moving multiple cards.
         bool kingMoved = false;     // prevents moving the same king twice
@@ -287,7 +773,7 @@ void Game::MovesFromTableau(QMoves & moves) const noexcept
             if (&fromPile == &toPile) continue;
 
             if (toPile.empty()) { 
-                if ( ! kingMoved 
+                if ( ! (R::Prunes(PruneKingOnce) && kingMoved)
                     && fromBase.Rank() == Card::King 
                     && fromPile.DownCount()) {
                     // toPile is empty, a king sits abottom fromPile's face-up
@@ -313,7 +799,8 @@ void Game::MovesFromTableau(QMoves & moves) const noexcept
                     // in the to pile, so a move is possible.
                     const unsigned moveCount = cardToCover.Rank() - fromTip.Rank();
                     assert(moveCount <= upCount);
-                    if (moveCount==upCount && (fromPile.DownCount() || NeedKingSpace())){
+                    if (moveCount==upCount 
+                            && (fromPile.DownCount() || NeedKingSpace() || !R::Prunes(PruneKingSpace))){
                         // This move will flip a face-down card or
                         // clear a column that's needed for a king.
                         // Move all the face-up cards on the from pile.
@@ -336,119 +823,28 @@ void Game::MovesFromTableau(QMoves & moves) const noexcept
     }
 }
 
-struct TalonFuture {
-    Card _card;
-    unsigned short _nMoves;
-    signed short _drawCount;
-    bool _recycle;
-
-    TalonFuture(const Card& card, unsigned nMoves, int draw, bool recycle)
-        : _card(card)
-        , _nMoves(nMoves)
-        , _drawCount(draw)
-        , _recycle(recycle)
-        {}
-};
-
-// Class to simulate draws and recycles of the talon and
-// return the top card of the simulated waste pile.
-class TalonSim{
-    const PileVec& _waste;
-    const PileVec& _stock;
-    unsigned _wSize;
-    unsigned _sSize;
-public:
-    TalonSim(const Game& game)
-        : _waste(game.WastePile())
-        , _stock(game.StockPile())
-        , _wSize(game.WastePile().size())
-        , _sSize(game.StockPile().size())
-        {}
-    unsigned WasteSize() const noexcept
-    {
-        return _wSize;
-    }
-    unsigned StockSize() const noexcept
-    {
-        return _sSize;
-    }
-    void Cycle() noexcept
-    {
-        _sSize = _wSize;
-        _wSize = 0;
-    }
-    void Draw(unsigned n) noexcept
-    {
-        n = std::min<unsigned>(n, _sSize);
-        _wSize += n;
-        _sSize -= n;
-    }
-    Card TopCard() const noexcept
-    {
-        if (_wSize <= _waste.size()){
-            return _waste[_wSize-1];
-        } else {
-            return *(_stock.end()-(_wSize-_waste.size()) );
-        }
-    }
-};
-
-// Return a vector of all the cards that can be played
-// from the talon (the stock and waste piles), along
-// with the number of moves required to reach each one
-// and the number of cards that must be drawn (or undrawn)
-// to reach each one.
-//
-// Enforces the limit on recycles
-typedef static_vector<TalonFuture,24> TalonFutureVec;
-static TalonFutureVec TalonCards(const Game & game) noexcept
-{
-    TalonFutureVec result;
-    const unsigned talonSize = game.WastePile().size() + game.StockPile().size();
-    if (talonSize == 0) return result;
-
-    TalonSim talon(game);
-    const unsigned originalWasteSize = talon.WasteSize();
-    const unsigned drawSetting = game.DrawSetting();
-    unsigned nMoves = 0;
-    unsigned nRecycles = 0;
-    unsigned maxRecycles = std::min(1U, game.RecycleLimit()-game.RecycleCount());
-
-    do {
-        if (talon.WasteSize()) {
-            result.emplace_back(talon.TopCard(), nMoves, 
-                talon.WasteSize()-originalWasteSize, nRecycles>0);
-        }	
-        if (talon.StockSize()) {
-            // Draw from the stock pile
-            nMoves++;
-            talon.Draw(drawSetting);
-        } else {
-            // Recycle the waste pile
-            nRecycles++;
-            talon.Cycle();
-        }
-    } while (talon.WasteSize() != originalWasteSize && nRecycles <= maxRecycles);
-    return result;
-}
-
 // Append to "moves" any available moves from the talon.
+template <class R>
 void Game::MovesFromTalon(QMoves & moves, const DominantMoveTester& tester) const noexcept
 {
+    const unsigned draw = R::Draw ? R::Draw : _drawSetting;
     // Look for move from the talon to tableau or foundation, including moves that become available 
     // after one or more draws.  
-    const TalonFutureVec talon(TalonCards(*this));
-    for (auto talonCard : talon){
+    const auto talonCards = TalonCards<R>(*this);
+    _talonLookAheadCut |= talonCards.Truncated();
+    for (auto talonCard : talonCards){
         bool recycle = talonCard._recycle;
         if (CanMoveToFoundation(talonCard._card)) {
             const auto pileNo = FoundationPileCode(talonCard._card.Suit());
             moves.AddStockMove(pileNo, talonCard._nMoves+1, talonCard._drawCount, recycle);
-            if (tester.IsMoveDominant(talonCard._card)){
-                if (_drawSetting == 1) {
+            if (R::Prunes(PruneDominant) && tester.IsMoveDominant(talonCard._card)){
+                if (draw == 1) {
                     break;		// This is best next move from among the remaining talon cards
                 } else
                     continue;  	// This is best move for this card.  A card further on might be a better move.
             }
+            if (!R::Prunes(PruneDominant) && talonCard._card.Rank() == Card::Ace)
+                continue;       // Aces stay off the tableau (see TableauCode()).
         }
             
         for (const auto& tPile : _tableau) {
@@ -467,13 +863,16 @@ void Game::MovesFromTalon(QMoves & moves, const DominantMoveTester& tester) cons
 }
 
 // Look for moves from foundation piles to tableau piles.
+template <class R>
 void Game::MovesFromFoundation(QMoves & moves, const DominantMoveTester& tester) const noexcept
 {
     for ( unsigned suitNo = 0; suitNo < SuitsPerDeck; ++ suitNo) {
         // Avoid generating moves whose reversals are dominant.
         auto suit = Card::SuitT(suitNo);
-        if (tester.IsReverseMoveDominant(suit)) continue;
         auto& fPile(_foundation[suit]);
+        // Aces stay on the foundation (see TableauCode()).
+        if (fPile.size() <= 1) continue;
+        if (R::Prunes(PruneReverseDominant) && tester.IsReverseMoveDominant(suit)) continue;
         const Card& top = fPile.back();
         for (const auto& tPile: _tableau) {
             if (tPile.size() > 0) {
@@ -497,14 +896,36 @@ void Game::MovesFromFoundation(QMoves & moves, const DominantMoveTester& tester)
 // Rather than generate individual draws from
 // stock to waste, it generates MoveSpec objects that represent one or more
 // draws and that expose a playable top waste card and then play that card.
+template <class R>
 void Game::NonDominantAvailableMoves(QMoves& moves, const DominantMoveTester& tester) const noexcept
 {
-    MovesFromTableau(moves);
-    MovesFromTalon(moves, tester); 
-    MovesFromFoundation(moves, tester);
+    MovesFromTableau<R>(moves);
+    MovesFromTalon<R>(moves, tester); 
+    MovesFromFoundation<R>(moves, tester);
     return;
 }
 
+// Instantiate AvailableMoves() for the Rules the solver uses
+#define INSTANTIATE_RULES(draw, limited, prune)                                 \
+    template void Game::DominantAvailableMoves<Rules<draw,limited,prune>>(      \
+        MoveCacheType&, const DominantMoveTester&) const noexcept;              \
+    template void Game::NonDominantAvailableMoves<Rules<draw,limited,prune>>(   \
+        QMoves&, const DominantMoveTester&) const noexcept;
+INSTANTIATE_RULES(0, true, PruneAll)
+INSTANTIATE_RULES(0, false, PruneAll)
+INSTANTIATE_RULES(1, true, PruneAll)
+INSTANTIATE_RULES(1, false, PruneAll)
+INSTANTIATE_RULES(3, true, PruneAll)
+INSTANTIATE_RULES(3, false, PruneAll)
+// For KSolveAStar() with one pruning rule left out
+INSTANTIATE_RULES(0, true, PruneAll & ~PruneDominant)
+INSTANTIATE_RULES(0, true, PruneAll & ~PruneReverseDominant)
+INSTANTIATE_RULES(0, true, PruneAll & ~PruneXYZ)
+INSTANTIATE_RULES(0, true, PruneAll & ~PruneKingOnce)
+INSTANTIATE_RULES(0, true, PruneAll & ~PruneKingSpace)
+INSTANTIATE_RULES(0, true, PruneAll & ~PruneDeadEnds)
+#undef INSTANTIATE_RULES
+
 static bool Valid(const Game& gm, 
                   unsigned from, 
                   unsigned to, 
@@ -549,10 +970,9 @@ bool Game::IsValid(XMove mv) const noexcept
 }
 
 // Enumerate the moves in a vector of MoveSpecs.
-std::vector<XMove> MakeXMoves(const Moves& solution, unsigned draw)
+std::vector<XMove> MakeXMoves(const Moves& solution, unsigned draw,
+                              unsigned stockSize, unsigned wasteSize)
 {
-    unsigned stockSize = 24;
-    unsigned wasteSize = 0;
     unsigned mvnum = 0;
     std::vector<XMove> result;
 
@@ -677,6 +1097,7 @@ std::string Peek (const Game&game)
     for (const auto& pile: piles){
         out << Peek(pile) << "\n";
     } 
+    out << "rc: " << game.RecycleCount() << "\n";
     return out.str();
 }
 
@@ -17,6 +17,8 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <limits>
+#include <climits>        // UCHAR_MAX
 #include <cassert>
 #include <sstream> 		// for stringstream
 #include <optional>
@@ -24,6 +26,7 @@
 #include <algorithm>
 
 #include "frystl/static_vector.hpp"
+#include "frystl/static_deque.hpp"
 namespace KSolveNames {
 
 using namespace frystl;    
@@ -41,6 +44,15 @@ inline unsigned QuotientRoundedUp(unsigned numerator, unsigned denominator)
     return (numerator+denominator-1)/denominator;
 }
 
+// Scramble the bits of x (the SplitMix64 finalizer).  Used to
+// hash the parts of a game state.
+inline uint64_t MixBits(uint64_t x) noexcept
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
 
 class Card
 {
@@ -100,6 +112,14 @@ std::optional<Card> CardFromString(const std::string& s) noexcept;
 
 static_assert(sizeof(Card) == 1, "Card must be 1 byte long");
 
+// Sets of cards, one bit per Card::Value()
+using CardMask = uint64_t;
+// The lower cards of card's suit
+inline CardMask LowerCards(Card card) noexcept
+{
+    return ((CardMask{1} << card.Rank()) - 1) << CardsPerSuit*card.Suit();
+}
+
 // Type to hold the cards in a pile after the deal.  None ever exceeds 24 cards.
 typedef static_vector<Card,24> PileVec;
 static_assert(sizeof(PileVec) <= 28, "PileVec should fit in 28 bytes");
@@ -253,7 +273,8 @@ class MoveSpec
 private:
     PileCodeT _from = PileCount;    // _from == Stock means stock MoveSpec
     PileCodeT _to   = PileCount;
-    unsigned char _nMoves = 0;
+    unsigned char _nMoves:7 = 0;
+    bool _endsStem:1 = false;       // used only by MoveTree
     union {
         unsigned char _initializer{0};
         // Non-stock MoveSpec
@@ -279,6 +300,7 @@ public:
         , _to(to)
         , _nMoves(nMoves)
         {
+            assert(nMoves < 128);
             _stock._recycle = false;
             _stock._drawCount = draw;
         }
@@ -324,6 +346,9 @@ public:
     bool IsLadderMove() const noexcept  {return (_from != Stock) & (_nMoves == 2);}
     bool FlipsTopCard() const noexcept  {return _nonStock._flipsTopCard;}   
     void FlipsTopCard(bool f) noexcept  {_nonStock._flipsTopCard = f;}  
+    // MoveTree marks the last MoveSpec in each stem it stores.
+    bool EndsStem() const noexcept      {return _endsStem;}
+    void EndsStem(bool e) noexcept      {_endsStem = e;}
 
 };
 static_assert(sizeof(MoveSpec) == 4, "MoveSpec must be 4 bytes long");
@@ -404,6 +429,14 @@ public:
         _nMoves -= Base::back().NMoves();
         Base::pop_back();
     }
+    // Append the MoveSpecs in [first,last), which are known
+    // to imply nMoves actual moves.
+    template <class Iter>
+    void append(Iter first, Iter last, unsigned nMoves)
+    {
+        _nMoves += nMoves;
+        Base::insert(Base::end(), first, last);
+    }
 };
 // Return a string to visualize a move for debugging
 std::string Peek(const MoveSpec& mv);
@@ -466,7 +499,9 @@ public:
 };
 
 typedef std::vector<XMove> XMoves;
-XMoves MakeXMoves(const Moves & moves, unsigned draw);
+// stockSize and wasteSize are the sizes of those piles where moves start.
+XMoves MakeXMoves(const Moves & moves, unsigned draw,
+                  unsigned stockSize=24, unsigned wasteSize=0);
 
 
 enum Dir: unsigned {
@@ -520,12 +555,10 @@ static Dir XYZ_Test(MoveSpec prevMove, MoveSpec trialMove) noexcept
     return keepLooking;
 }    
 
-// Return true if this move cannot be in a minimum solution because
-// when combined with an earlier move, the combined effect could  have
-// been achieved at the time of the earlier move. That means this sequence
-// does in two moves what other sequences will do in one.
+// XYZ_Move() for any sequence of moves, scanning back from the
+// most recent move to the one that decides.
 template <class V>
-static bool XYZ_Move(MoveSpec trialMove, const V& movesMade) noexcept
+static bool XYZ_Scan(MoveSpec trialMove, const V& movesMade) noexcept
 {
     const auto Y = trialMove.From();
     if (Y == Stock || Y == Waste) return false; 
@@ -555,6 +588,118 @@ static bool XYZ_Move(MoveSpec trialMove, const V& movesMade) noexcept
     return false;
 }
 
+// A MoveCounter that also remembers, for each pile, the position of the
+// last MoveSpec in the sequence that moved cards to or from it.  
+// XYZ_Test() always decides at the latest move that touched the trial
+// move's from-pile or to-pile, so with these positions XYZ_Move() can 
+// go straight to that move instead of scanning back to it.
+//
+// The positions are counted in half-moves so that the move to the
+// foundation implied by a ladder move comes after its tableau-to-tableau
+// move, as in XYZ_Scan().  For each MoveSpec, the positions it replaced
+// are kept so pop_back() can restore them.  Change the sequence only 
+// through push_back(), pop_back(), append() and clear().
+template <unsigned Capacity>
+class LastTouchSequence : public MoveCounter<static_deque<MoveSpec,Capacity>>
+{
+    using Base = MoveCounter<static_deque<MoveSpec,Capacity>>;
+    // 1 + the half-move position of the last touch, or 0 if none
+    using PositionT = uint16_t;
+    static_assert(2*Capacity < std::numeric_limits<PositionT>::max());
+    using Replaced = std::array<PositionT,3>;     // from, to, ladder piles
+
+    std::array<PositionT,PileCount> _lastTouch{};
+    static_vector<Replaced,Capacity> _replaced;
+
+    void Record(MoveSpec mv) noexcept
+    {
+        const PositionT pos = 2*_replaced.size() + 1;
+        Replaced& old = _replaced.emplace_back();
+        old[0] = _lastTouch[mv.From()];
+        old[1] = _lastTouch[mv.To()];
+        _lastTouch[mv.To()] = pos;
+        if (mv.IsLadderMove()) {
+            old[2] = _lastTouch[mv.LadderPileCode()];
+            _lastTouch[mv.LadderPileCode()] = pos+1;
+            _lastTouch[mv.From()] = pos+1;
+        } else {
+            _lastTouch[mv.From()] = pos;
+        }
+    }
+    void Forget(MoveSpec mv) noexcept
+    {
+        const Replaced& old = _replaced.back();
+        if (mv.IsLadderMove()) 
+            _lastTouch[mv.LadderPileCode()] = old[2];
+        _lastTouch[mv.To()] = old[1];
+        _lastTouch[mv.From()] = old[0];
+        _replaced.pop_back();
+    }
+    // The move at a given 1-based half-move position, as XYZ_Scan() sees it
+    MoveSpec MoveAt(PositionT pos) const noexcept
+    {
+        MoveSpec mv = (*this)[(pos-1)/2];
+        if (mv.IsLadderMove()) {
+            if (pos%2 == 0)
+                return MoveSpec(mv.From(), mv.LadderPileCode(), 1, mv.FlipsTopCard());
+            mv.FlipsTopCard(false);
+        }
+        return mv;
+    }
+public:
+    void clear() noexcept
+    {
+        Base::clear();
+        _lastTouch.fill(0);
+        _replaced.clear();
+    }
+    void push_back(const MoveSpec& mv)
+    {
+        Base::push_back(mv);
+        Record(mv);
+    }
+    void pop_back() noexcept
+    {
+        Forget(Base::back());
+        Base::pop_back();
+    }
+    template <class Iter>
+    void append(Iter first, Iter last, unsigned nMoves)
+    {
+        Base::append(first, last, nMoves);
+        while (_replaced.size() < Base::size())
+            Record((*this)[_replaced.size()]);
+    }
+    void push_front(const MoveSpec&) = delete;
+    void pop_front() = delete;
+
+    // Same result as XYZ_Scan(trialMove, *this)
+    bool XYZ_Move(MoveSpec trialMove) const noexcept
+    {
+        const auto Y = trialMove.From();
+        bool result = false;
+        if (Y != Stock && Y != Waste) {
+            const PositionT pos = std::max(_lastTouch[Y], _lastTouch[trialMove.To()]);
+            result = pos && XYZ_Test(MoveAt(pos), trialMove) == returnTrue;
+        }
+        assert(result == XYZ_Scan(trialMove, *this));
+        return result;
+    }
+};
+
+// Return true if this move cannot be in a minimum solution because
+// when combined with an earlier move, the combined effect could  have
+// been achieved at the time of the earlier move. That means this sequence
+// does in two moves what other sequences will do in one.
+template <class V>
+static bool XYZ_Move(MoveSpec trialMove, const V& movesMade) noexcept
+{
+    if constexpr (requires {movesMade.XYZ_Move(trialMove);})
+        return movesMade.XYZ_Move(trialMove);
+    else
+        return XYZ_Scan(trialMove, movesMade);
+}
+
 // Remove some provably non-optimal moves.
 template <class V1, class V2>
 static void XYZ_Filter(V1& newMoves, const V2& movesMade)
@@ -568,6 +713,91 @@ static void XYZ_Filter(V1& newMoves, const V2& movesMade)
 
 using QMoves = QMovesTemplate<43>;
 
+// The rules AvailableMoves() and the solver use to leave out moves
+// that cannot be needed for a minimum solution.  Each is a bit in a 
+// Rules type's Prune, so the checks for rules it leaves out compile away.
+enum PruneRule : unsigned
+{
+    // Return a move to a short foundation pile alone, and in draw 1,
+    // look no further through the talon than such a card.
+    PruneDominant = 1,
+    // Never move a card from its foundation pile when moving it 
+    // back would be dominant.
+    PruneReverseDominant = 2,
+    // Drop moves XYZ_Move() finds could have been combined with
+    // an earlier move.
+    PruneXYZ = 4,
+    // Move a king from the tableau to only one empty column.
+    PruneKingOnce = 8,
+    // Move all the face-up cards off a pile without flipping a card
+    // only when another empty column is needed for a king.
+    PruneKingSpace = 16,
+    // Drop children in which Deadlocked() finds cards that can
+    // never move.  This one is applied by the solver.
+    PruneDeadEnds = 32,
+    PruneAll = 63
+};
+// PruneRule names for messages, in bit order
+constexpr std::array<const char*,6> PruneRuleNames
+    {"dominant", "reverse-dominant", "xyz", "king-once", "king-space", "dead-ends"};
+
+// What is known at compile time about the rules a game is played by.
+// Functions that take a Rules type use it in place of the game's
+// run-time settings, so in the solver instantiated for one draw setting
+// the tests of that setting fold away.  Draw is the number of cards
+// to draw, or 0 if it is known only at run time.  RecycleLimited may be
+// false only for a game whose RecycleLimited() is false.  Prune is the
+// set of PruneRules AvailableMoves() applies.
+template <unsigned DrawT, bool RecycleLimitedT, unsigned PruneT = PruneAll>
+struct Rules
+{
+    static constexpr unsigned Draw{DrawT};
+    static constexpr bool RecycleLimited{RecycleLimitedT};
+    static constexpr unsigned Prune{PruneT};
+    static constexpr bool Prunes(PruneRule rule) noexcept {return Prune & rule;}
+};
+using RunTimeRules = Rules<0,true>;
+
+// The most talon cards TalonCards() can find: one for each position
+// of the talon it visits.
+constexpr unsigned MaxTalonLookAhead{24};
+
+// Everything that changes in a Game as moves are made, in one cache line.
+// _cards holds the cards not on the foundation piles, pile by pile in
+// the order of PileCodeT (waste, tableau, stock), each pile bottom first.
+// The sizes of the waste and tableau piles divide them; the stock gets
+// the rest.  The foundation piles' cards follow from their sizes, and
+// the entries in _cards past the stock are unspecified.
+struct alignas(64) GameSnapshot
+{
+    std::array<Card,CardsPerDeck> _cards;
+    std::array<unsigned char,TableauSize> _tableau;  // size | downCount<<5
+    unsigned char   _wasteSize;
+    uint16_t        _foundationSizes;   // 4 bits each, Foundation1C lowest
+    unsigned char   _recycleCount;
+    unsigned char   _kingSpaces;
+};
+static_assert(sizeof(GameSnapshot) == 64, "GameSnapshot should fill one cache line");
+
+// A position a Game can start from instead of a deal, such as one
+// reached in a game being played elsewhere.  Each pile is listed
+// bottom first.  The foundation piles' cards follow from their sizes.
+struct GamePosition
+{
+    PileVec _waste;
+    std::array<PileVec,TableauSize> _tableau;
+    std::array<unsigned,TableauSize> _downCount{};   // face-down cards in each
+    PileVec _stock;
+    std::array<unsigned,SuitsPerDeck> _foundationSizes{};
+    unsigned _recycleCount{0};
+    bool operator==(const GamePosition&) const = default;
+};
+// Return a message telling why position could not arise in a game,
+// or an empty string if it could.
+std::string PositionError(const GamePosition& position);
+
+struct Kernels;     // see Kernels.hpp
+
 class Game
 {
 public:
@@ -584,11 +814,50 @@ private:
     unsigned char   _recycleLimit;            // max number of recycles allowed
     unsigned char   _recycleCount;            // n of recycles so far
     unsigned char   _kingSpaces;              // empty columns + columns with kings on bottom
+    unsigned char   _talonLookAhead{MaxTalonLookAhead}; // max talon cards to look at
+    mutable bool    _talonLookAheadCut{false};  // true if that ever hid a card
 
     const CardDeck _deck;
+    // Where Deal() starts a game built from a GamePosition
+    const std::optional<GameSnapshot> _startPosition;
+    // The kernels (see Kernels.hpp) this Game and its copies use,
+    // chosen once when it is built
+    const Kernels*  _kernels;
     using MoveCacheType = QMovesTemplate<9>;
     mutable MoveCacheType _domMovesCache;
 
+    // TableauCode() of each tableau pile and the sum of their
+    // MixBits(), kept up to date as moves are made
+    std::array<uint32_t,TableauSize> _tableauCodes;
+    uint64_t        _tableauHash;
+    // The misorder count (see Kernels.hpp) of the face-down cards and
+    // the first face-up card of each tableau pile and their sum, kept up
+    // to date as moves are made.  They change only when a card is flipped.
+    std::array<unsigned char,TableauSize> _tableauMisorders;
+    unsigned char   _tableauMisorderSum;
+    // The misorder count of the waste pile, counted when first asked for
+    // after a move changes the waste pile
+    mutable unsigned char _wasteMisorders;
+    mutable bool    _wasteMisordersValid{false};
+    // The cards CrossPileBlocks() looks at and which wait for which.
+    // _vertices[pile][downCount] is the set of them in pile at or below
+    // index downCount.
+    struct CrossPileGraph
+    {
+        std::array<uint32_t,32> _waitsFor;
+        std::array<uint32_t,32> _waitedFor;
+        std::array<std::array<uint32_t,TableauSize>,TableauSize> _vertices;
+    };
+    // The graph for the start position.  Moves only take cards out of
+    // it, so the cards left are those at or below the first face-up card
+    // of each pile, and the face-down counts of the piles tell which.
+    // Empty (so CrossPileBlocks() is 0) until BuildCrossPileGraph().
+    CrossPileGraph  _crossPileGraph{};
+    // If set, the table of CrossPileBlocks() this Game looks up instead
+    // of searching the graph (see UseCrossPileCosts())
+    const std::array<unsigned char,5040>* _crossPileCosts{nullptr};
+    unsigned char   _crossPileBlocks;
+
 public:
     class DominantMoveTester
     {
@@ -620,31 +889,68 @@ private:
     // Return true if any more empty columns are needed for kings
     bool NeedKingSpace() const noexcept {return _kingSpaces < SuitsPerDeck;}
 
+    // These are instantiated in Game.cpp for each Rules type.
+    template <class R>
     void DominantAvailableMoves(MoveCacheType & moves, const DominantMoveTester& tester) const noexcept;
-
+    template <class R>
     void NonDominantAvailableMoves(QMoves& avail, const DominantMoveTester& tester) const noexcept;
     // Parts of NonDominantAvailableMoves()
+    template <class R>
     void MovesFromTableau(QMoves & moves) const noexcept;
+    template <class R>
     void MovesFromTalon(QMoves & moves, const DominantMoveTester& tester) const noexcept;
+    template <class R>
     void MovesFromFoundation(QMoves & moves, const DominantMoveTester& tester) const noexcept;
 
     auto& AllPiles() {
         return *reinterpret_cast<std::array<Pile,PileCount>* >(&_waste);
     }
+    void SetTableauCode(const Pile& pile, uint32_t code) noexcept;
+    void ResetTableauCodes() noexcept;
+    void SetTableauMisorders(const Pile& pile) noexcept;
+    void ResetMisorders() noexcept;
+    void CountWasteMisorders() const noexcept;
+    static CrossPileGraph MakeCrossPileGraph(const TableauType& tableau) noexcept;
+    void SetCrossPileBlocks() noexcept;
+    void BuildCrossPileGraph() noexcept;
     
 public:
     Game(CardDeck deck,
          unsigned draw=1,
          unsigned recyleLimit=-1);
+    // Start from position.  PositionError(position) must be empty.
+    // Deal() returns to position, so the solver searches only
+    // the rest of the game.
+    Game(const GamePosition& position,
+         unsigned draw=1,
+         unsigned recycleLimit=-1);
     const Pile & WastePile() const noexcept    	    {return _waste;}
     const Pile & StockPile() const noexcept    	    {return _stock;}
     const FoundationType& Foundation()const noexcept{return _foundation;}
-    FoundationType& Foundation() noexcept           {return _foundation;}  // needed in unittests
-    TableauType& Tableau() noexcept                 {return _tableau;}     // needed in unittests
+    // Needed in unittests.  Changes made through these are not reflected in 
+    // Hash() or the misorder counts.
+    FoundationType& Foundation() noexcept           {return _foundation;}
+    TableauType& Tableau() noexcept                 {return _tableau;}
     const TableauType& Tableau() const noexcept     {return _tableau;}
     unsigned DrawSetting() const noexcept           {return _drawSetting;}
     unsigned RecycleLimit() const noexcept          {return _recycleLimit;}
     unsigned RecycleCount() const noexcept          {return _recycleCount;}
+    // False if the game was created with the default recycle
+    // limit (-1), which means any number of recycles is allowed
+    bool RecycleLimited() const noexcept            {return _recycleLimit != UCHAR_MAX;}
+    // Limit the talon cards AvailableMoves() considers playing to the
+    // first n (1 to MaxTalonLookAhead) TalonCards() finds.  A game
+    // searched with a limit may miss its shortest solution or any
+    // solution.  TalonLookAheadCut() tells whether the limit has
+    // ever hidden a card since the limit was set.
+    void SetTalonLookAhead(unsigned n) noexcept
+    {
+        assert(0 < n && n <= MaxTalonLookAhead);
+        _talonLookAhead = n;
+        _talonLookAheadCut = false;
+    }
+    unsigned TalonLookAhead() const noexcept        {return _talonLookAhead;}
+    bool TalonLookAheadCut() const noexcept         {return _talonLookAheadCut;}
     const std::array<Pile,PileCount>& AllPiles() const {
         return *reinterpret_cast<const std::array<Pile,PileCount>* >(&_waste);
     }
@@ -660,28 +966,109 @@ public:
     bool        IsValid(MoveSpec mv) const noexcept;
     bool        IsValid(XMove xmv) const noexcept;
     bool        GameOver() const noexcept;
+    // True if the stock and waste piles are empty and no tableau card
+    // is face down.  Such a game can be won by moving each card left to
+    // its foundation pile, lowest rank first, so it takes exactly as many
+    // more moves as there are cards in the tableau, and MinimumMovesLeft()
+    // returns that many.
+    bool        CanAutoComplete() const noexcept;
+    // Make the moves that win a game for which CanAutoComplete() is
+    // true and append them to moves.
+    void        AutoComplete(Moves& moves) noexcept;
+    // Save() captures the position; Restore() returns to it much faster 
+    // than Deal() and replaying the moves that led to it.  Restore() 
+    // only a snapshot Saved from a Game with the same deck and settings.
+    // It clears the cache ClearMoveCache() clears.
+    GameSnapshot Save() const noexcept;
+    void        Restore(const GameSnapshot& snapshot) noexcept;
+
+    // A code for the face-up cards in each tableau pile.  Since a pile's
+    // face-up cards are in sequence, they can be identified by the lowest
+    // one, which of the others are in major suits, and how many there are.
+    // The face-down cards are implied.  An empty pile's code is zero.
+    // The code is ((suit<<4 | rank)<<11 | isMajor)<<4 | upCount, where
+    // the top card's isMajor bit is lowest.
+    uint32_t TableauCode(const Pile& pile) const noexcept;
+    // The fewest extra moves the face-down and first face-up cards in
+    // tableau must make because they wait for each other to reach their
+    // foundation piles (see Game.cpp).  Cards TableauMisorders() counts
+    // are left out.
+    static unsigned CrossPileBlocks(const TableauType& tableau) noexcept;
+    // A cache of CrossPileBlocks() for each combination of face-down 
+    // counts of the tableau piles (7! of them).  It depends on the deal,
+    // so KSolveAStar() makes one per solve rather than keeping it.
+    using CrossPileCosts = std::array<unsigned char,5040>;
+    CrossPileCosts MakeCrossPileCosts() const noexcept;
+    // Look CrossPileBlocks() up in costs from now on, rather than finding
+    // it after each flip.  costs must come from MakeCrossPileCosts() for
+    // this deal, and must outlive this Game and its copies, which share it.
+    void UseCrossPileCosts(const CrossPileCosts* costs) noexcept;
+    const std::array<uint32_t,TableauSize>& TableauCodes() const noexcept
+                                                    {return _tableauCodes;}
+    // A code for the sizes of the stock and foundation piles
+    uint32_t OtherPilesCode() const noexcept
+    {
+        return ((((_stock.size()
+                <<4 | _foundation[0].size())
+                <<4 | _foundation[1].size())
+                <<4 | _foundation[2].size())
+                <<4 | _foundation[3].size());
+    }
+    // The misorder counts MinimumMovesLeft() adds up: the sum over the
+    // tableau piles of each one's face-down cards and first face-up card,
+    // and the waste pile's.  Reading either usually costs no more than
+    // reading a member; the waste pile's is counted again only after
+    // a move has changed the waste pile.
+    unsigned TableauMisorders() const noexcept      {return _tableauMisorderSum;}
+    unsigned CrossPileBlocks() const noexcept       {return _crossPileBlocks;}
+    const Kernels& KernelSet() const noexcept       {return *_kernels;}
+    unsigned WasteMisorders() const noexcept
+    {
+        if (!_wasteMisordersValid) CountWasteMisorders();
+        return _wasteMisorders;
+    }
+    // A hash of the game state that does not depend on the order of
+    // the tableau piles.  Kept up to date by MakeMove() and UnMakeMove(), 
+    // so it costs about the same as an addition.  GameStateMemory's 
+    // Hasher computes the same value from a GameState.
+    uint64_t Hash() const noexcept
+    {
+        return _tableauHash + MixBits(OtherPilesCode());
+    }
 
-    // Return a vector of the available moves that pass the XYZ_Move filter.
-    // Dominant moves are returned one at a time; others, all at once.
-    template <class V>
+    // Forget any dominant moves AvailableMoves() has found but not yet
+    // returned.  A caller that takes back a move AvailableMoves() returned
+    // alone and then tries a different move must call this first.  The 
+    // solver never does that.
+    void ClearMoveCache() noexcept                  {_domMovesCache.clear();}
+
+    // Return a vector of the available moves that pass the pruning
+    // rules in R::Prune.  Dominant moves are returned one at a time; 
+    // others, all at once.  R may be any Rules type Game.cpp 
+    // instantiates that agrees with this game.
+    template <class R = RunTimeRules, class V>
     QMoves AvailableMoves(const V& movesMade) noexcept
     {
         QMoves avail;
         if (GameOver()) return avail;		// game won
         DominantMoveTester tester(*this);
 
-        if (_domMovesCache.empty()) {
-            DominantAvailableMoves(_domMovesCache, tester);
-            XYZ_Filter(_domMovesCache, movesMade);
-        }
-        if (_domMovesCache.size()) {
-            avail.push_back(_domMovesCache.back());
-            _domMovesCache.pop_back();
-            return avail;
+        if constexpr (R::Prunes(PruneDominant)) {
+            if (_domMovesCache.empty()) {
+                DominantAvailableMoves<R>(_domMovesCache, tester);
+                if constexpr (R::Prunes(PruneXYZ))
+                    XYZ_Filter(_domMovesCache, movesMade);
+            }
+            if (_domMovesCache.size()) {
+                avail.push_back(_domMovesCache.back());
+                _domMovesCache.pop_back();
+                return avail;
+            }
         }
 
-        NonDominantAvailableMoves(avail, tester);
-        XYZ_Filter(avail, movesMade);
+        NonDominantAvailableMoves<R>(avail, tester);
+        if constexpr (R::Prunes(PruneXYZ))
+            XYZ_Filter(avail, movesMade);
         return avail;
     }
 
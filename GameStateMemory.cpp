@@ -2,47 +2,18 @@
 
 #include <algorithm>        // max
 #include "GameStateMemory.hpp"
+#include "Kernels.hpp"              // Kernels::_sortTableauCodes
 
 namespace KSolveNames {
 
-// 32 bytes --> 21 bits
-static inline uint32_t DeflateTableau(const Pile& cards) noexcept
-{
-    uint32_t result {0};
-    if (cards.size()) {
-        // The rules for moving to the tableau piles guarantee
-        // all the face-up cards in such a pile can be identified
-        // by identifying the bottom card (the first face-up card)
-        // and whether each other face-up card is from 
-        // a major suit (hearts or spades) or not.
-        //
-        // The face-up cards in a tableau pile cannot number
-        // more than 12, since AvailableMoves() will never move an
-        // ace there.
-        unsigned isMajor{0};
-        for (Card card : cards | views::drop(cards.DownCount()+1)) {
-            isMajor <<=1 ;
-            isMajor |= card.IsMajor();
-        }
-        const Card top = cards.Top();
-        result =  ((top.Suit()
-                    <<4  | top.Rank())
-                    <<11 | isMajor)
-                    <<4  | cards.UpCount();
-    }
-    return result;
-}
 GameState::GameState(const Game& game, unsigned moveCount) noexcept
     : _moveCount(moveCount)
 {
-    std::array<uint32_t,TableauSize> tableauState;
-    const auto& tableau = game.Tableau();
-    for (unsigned i = 0; i<TableauSize; ++i) {
-        tableauState[i] = DeflateTableau(tableau[i]);
-    }
+    // Game keeps a 21-bit code for each tableau pile
+    TableauCodeArray tableauState;
     // Sort the tableau states because tableaus that are identical
     // except for order are considered equal
-    ranges::sort(tableauState);
+    game.KernelSet()._sortTableauCodes(game.TableauCodes(), tableauState);
 
     _part0 =          (PartType(tableauState[0])
                 <<21 | PartType(tableauState[1]))
@@ -50,13 +21,8 @@ GameState::GameState(const Game& game, unsigned moveCount) noexcept
     _part1 =          (PartType(tableauState[3])
                 <<21 | PartType(tableauState[4]))
                 <<21 | PartType(tableauState[5]);
-    auto& fnd{game.Foundation()};
-    _part2 =       ((((PartType(tableauState[6])
-                <<5  | game.StockPile().size())
-                <<4  | fnd[0].size())
-                <<4  | fnd[1].size()) 
-                <<4  | fnd[2].size()) 
-                <<4  | fnd[3].size();
+    _part2 =          PartType(tableauState[6])
+                <<21 | game.OtherPilesCode();
 }
 
 GameStateMemory::GameStateMemory() noexcept
@@ -70,7 +36,7 @@ bool GameStateMemory::IsShortPathToState(const Game& game, unsigned moveCount) n
     const GameState newState{game,moveCount};
     bool valueChanged{false};
     bool isNewKey = _states.lazy_emplace_l(
-        newState,						// (key, value)
+        HashedGameState{newState, game.Hash()},     // (key, value)
         [&](auto& oldState) {	// run behind lock if key found
             if (moveCount < oldState._moveCount) {
                 oldState._moveCount = moveCount;
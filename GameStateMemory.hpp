@@ -46,14 +46,46 @@ struct GameState {
     }
 };
 static_assert(sizeof(GameState) == 24);
+
+// A GameState along with the Hash() of the Game it was made from, 
+// for looking up a state without hashing it again.
+struct HashedGameState {
+    const GameState& _state;
+    size_t _hash;
+};
+
+// Computes from a GameState the same hash Game::Hash() keeps 
+// for a game: the sum of MixBits() of each part.  The hash map 
+// calls it only when it rehashes.
 struct Hasher
 {
+    using is_transparent = void;
     size_t operator() (const GameState & gs) const noexcept
     {
-        return 	  gs._part0
-                ^ gs._part1
-                ^ gs._part2
-                ;
+        const uint64_t mask = (uint64_t{1}<<21) - 1;
+        return    MixBits(gs._part0>>42) + MixBits(gs._part0>>21 & mask) + MixBits(gs._part0 & mask)
+                + MixBits(gs._part1>>42) + MixBits(gs._part1>>21 & mask) + MixBits(gs._part1 & mask)
+                + MixBits(gs._part2>>21) + MixBits(gs._part2 & mask);
+    }
+    size_t operator() (const HashedGameState & hgs) const noexcept
+    {
+        return hgs._hash;
+    }
+};
+struct StateEqual
+{
+    using is_transparent = void;
+    bool operator() (const GameState& a, const GameState& b) const noexcept
+    {
+        return a == b;
+    }
+    bool operator() (const GameState& a, const HashedGameState& b) const noexcept
+    {
+        return a == b._state;
+    }
+    bool operator() (const HashedGameState& a, const GameState& b) const noexcept
+    {
+        return a._state == b;
     }
 };
 
@@ -63,7 +95,7 @@ private:
     typedef gtl::parallel_flat_hash_set< 
             GameState, 								// member type
             Hasher,									// hash function
-            gtl::priv::hash_default_eq<GameState>,  // == function
+            StateEqual,                             // == function
             gtl::priv::Allocator<GameState >, 
             11U, 									// log2(number of submaps)
             std::mutex								// mutex type
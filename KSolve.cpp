@@ -38,6 +38,7 @@ CardDeck ReversedPysolDeck(const string& s);
 CardDeck DeckLoader(string const& cardSet, const int order[CardsPerDeck]);
 CardDeck Shuffle1(int &seed);
 CardDeck SolitaireDeck(const string& s);
+optional<GamePosition> PeekPosition(const string& s);
 string GameDiagram(const Game& game, unsigned minMoves);
 string GameDiagramPysol(const Game& game);
 string GetMoveInfo(XMove xmove, const Game& game);
@@ -63,8 +64,11 @@ TokenList Tokenize(const string& text, string separators)
     return result;
 }
 
-CardDeck LoadDeck(string const& f, unsigned int & index) {
+// Load the next deal from f into the returned deck, or the next
+// position into position.
+CardDeck LoadDeck(string const& f, unsigned int & index, optional<GamePosition>& position) {
     CardDeck deck;
+    position.reset();
     while (index < f.size() && f[index] == '\r' || f[index] == '\n' || f[index] == '\t' || f[index] == ' ') { index++; }
     if (index >= f.size()) { return deck; }
     int gameType = 0;
@@ -94,6 +98,14 @@ CardDeck LoadDeck(string const& f, unsigned int & index) {
         while (index < f.size() && f[index++] != '\n') {}
         int seed = stoi(f.substr(startIndex, index - startIndex));
         deck = NumberedDeal(seed);
+    } else if (f[index] == 'W' || f[index] == 'w') {
+        // A position as Peek() writes it: one line for each pile, 
+        // starting with "wa:", and one for the recycle count
+        int lineCount = 0;
+        while (index < f.size() && lineCount < PileCount+1) {
+            if (f[index++] == '\n') { lineCount++; }
+        }
+        position = PeekPosition(f.substr(startIndex, index - startIndex));
     } else {
         while (index < f.size() && f[index++] != '\n') {}
         deck = SolitaireDeck(f.substr(startIndex, index - startIndex));
@@ -112,6 +124,8 @@ int main(int argc, char * argv[]) {
     bool showMoves = false;
     CardDeck deck;
     int drawCount = 1;
+    string moveTreeDirectory;
+    int talonLookAhead = MaxTalonLookAhead;
 
     for (int i = 1; i < argc; i++) {
         if (_stricmp(argv[i], "-draw") == 0 || _stricmp(argv[i], "-dc") == 0) {
@@ -168,9 +182,21 @@ int main(int argc, char * argv[]) {
             threads = atoi(argv[i + 1]);
             if (threads < 0) { cerr << "-THREADS requires a non-negative number\n"; return 100; }
             i++;
+        } else if (_stricmp(argv[i], "-mapdir") == 0 || _stricmp(argv[i], "-md") == 0) {
+            if (i + 1 >= argc) { cerr << "No directory after -MAPDIR.\n"; return 100; }
+            moveTreeDirectory = argv[i + 1];
+            i++;
+        } else if (_stricmp(argv[i], "-fast") == 0 || _stricmp(argv[i], "-f") == 0) {
+            if (i + 1 >= argc) { cerr << "No number after -FAST.\n"; return 100; }
+            if (!IsNumber(argv[i + 1])) {cerr << "\"" << argv[i] << " " << argv[i + 1] 
+                    << "\" A number must be specified. \n"; return 100;}
+            talonLookAhead = atoi(argv[i + 1]);
+            if (talonLookAhead < 1 || talonLookAhead > int(MaxTalonLookAhead)) 
+                { cerr << "Please specify a talon look-ahead from 1 to 24.\n"; return 100; }
+            i++;
     } else if (argv[i][0] == '-') {
             cout << "KSolve\nSolves games of Klondike (Patience) solitaire minimally.\n\n";
-            cout << "KSolve [-dc #] [-d str] [-g #] [-ran #] [-r] [-o #] [-mvs] [-mxm] [-t] [-f] [Path]\n\n";
+            cout << "KSolve [-dc #] [-d str] [-g #] [-ran #] [-r] [-o #] [-mvs] [-mxm] [-t] [-md dir] [-f] [Path]\n\n";
             cout << "  -draw # [-dc #]       Sets the draw count to use when solving. Defaults to 1.\n";
             cout << "  -deck str [-d str]    Loads the deck specified by the string.\n";
             cout << "  -game # [-g #]        Loads a random game with seed #.\n";
@@ -183,10 +209,12 @@ int main(int argc, char * argv[]) {
             cout << "  -mvlimit # [-mxm #]   Sets the maximum size of the move tree\n";
             cout << "                        Defaults to 20 million moves.\n";
             cout << "  -threads # [-t #]     Sets the number of threads. Defaults to hardware threads.\n";
+            cout << "  -mapdir dir [-md dir] Keeps the move tree in a temporary file in directory dir\n";
+            cout << "                        so it can be paged out. Defaults to main memory.\n";
             cout << "  -fast # [-f #]        Limits talon look-ahead.  Enter 1 to 24.  1 is fastest,\n";
             cout << "                        and most likely to give a non-minimal result or even\n";
             cout << "                        no result for a solvable deal. 24 is like leaving this out.\n";
-            cout << "  Path                  Solves deals specified in the file.\n";
+            cout << "  Path                  Solves deals or positions specified in the file.\n";
             return 100;
         } else {
             if (commandLoaded) { cerr << "Only one method can be specified (deck/game/file).\n"; return 100; }
@@ -205,13 +233,21 @@ int main(int argc, char * argv[]) {
         {cerr << "No game is specified (-deck, -game, -ran, or a file name)\n"; return 100;}
 
     unsigned int fileIndex = 0;
+    optional<GamePosition> position;
     do {
         if (fileContents.size() > fileIndex) {
-            if ((deck = LoadDeck(fileContents, fileIndex)).empty()) {
+            deck = LoadDeck(fileContents, fileIndex, position);
+            if (deck.empty() && !position) {
                 continue;
             }
         }
-        Game game(deck,drawCount);
+        Game game = position ? Game(*position,drawCount) : Game(deck,drawCount);
+        const unsigned stockSize = game.StockPile().size();
+        const unsigned wasteSize = game.WastePile().size();
+        unsigned flips = 0;
+        for (const Pile& pile: game.Tableau()) {
+            flips += pile.DownCount();
+        }
         if (outputMethod == 0) {
             cout << GameDiagram(game,0) << "\n\n";
         } else if (outputMethod == 1) {
@@ -219,7 +255,10 @@ int main(int argc, char * argv[]) {
         }
 
         auto startTime = steady_clock::now();
-        KSolveAStarResult outcome = KSolveAStar(game, moveLimit, threads);
+        KSolveAStarResult outcome = KSolveAStar(game, moveLimit, threads, moveTreeDirectory, talonLookAhead);
+        if (moveTreeDirectory.size() && !outcome._moveTreeMapped) {
+            cerr << "Unable to map a file in " << moveTreeDirectory << ". Using main memory.\n";
+        }
         auto & result(outcome._code);
         Moves & moves(outcome._solution); 
         unsigned moveCount = MoveCount(moves);
@@ -232,7 +271,7 @@ int main(int argc, char * argv[]) {
                 cout << "Solved in ";
             }
             unsigned cycles = RecycleCount(moves);
-            cout << moveCount << " moves + 21 flips in " << cycles+1; 
+            cout << moveCount << " moves + " << flips << " flips in " << cycles+1; 
             if (cycles == 0) {
                 cout  << " pass.";
             } else {
@@ -249,7 +288,7 @@ int main(int argc, char * argv[]) {
         cout << setprecision(4) << outcome._moveTreeSize/1e6 << " million moves in the move tree.\n";
         if (outputMethod < 2 && replay && canReplay) {
             game.Deal();
-            XMoves xmoves(MakeXMoves(moves,game.DrawSetting()));
+            XMoves xmoves(MakeXMoves(moves,game.DrawSetting(),stockSize,wasteSize));
             cout << "----------------------------------------\n"; 
             for (XMove xmove: xmoves) {
                 bool isTalonMove = xmove.To() == Stock || xmove.To() == Waste;
@@ -267,7 +306,7 @@ int main(int argc, char * argv[]) {
             }
         }
         if (showMoves && canReplay) {
-            XMoves xmoves(MakeXMoves(moves,game.DrawSetting()));
+            XMoves xmoves(MakeXMoves(moves,game.DrawSetting(),stockSize,wasteSize));
             string out = MovesMade(xmoves);
             cout << out << "\n" << endl;
         } else if (showMoves) {
@@ -534,6 +573,93 @@ CardDeck SolitaireDeck(string const& cardSet) {
     }
     return result;
 }
+// Read the cards in text into pile.  Prints an error message
+// and returns false if any is invalid or there are too many.
+static bool ReadCards(const string& text, PileVec& pile)
+{
+    for (const string& tok: Tokenize(text, " \t\r")) {
+        optional<Card> cd = StringToCard(tok);
+        if (!cd) return false;
+        if (pile.size() == pile.capacity()) {
+            cerr << "Too many cards in \"" << text << "\"" << endl;
+            return false;
+        }
+        pile.push_back(*cd);
+    }
+    return true;
+}
+
+// Parse a position in the form Peek(const Game&) writes: a line for each
+// pile in the order of PileCodeT, each starting with the pile's name and 
+// a colon, then a line "rc: #" with the recycle count.  Prints an error 
+// message and returns nothing if it is not a valid position.
+optional<GamePosition> PeekPosition(string const& text)
+{
+    static const string names[PileCount+1] 
+        {"wa","t1","t2","t3","t4","t5","t6","t7","st","cb","di","sp","ht","rc"};
+    GamePosition result;
+    TokenList lines = Tokenize(text, "\n");
+    if (lines.size() != PileCount+1) {
+        cerr << "A position needs " << PileCount+1 << " lines.  This one has " 
+             << lines.size() << "." << endl;
+        return nullopt;
+    }
+    for (unsigned i = 0; i < lines.size(); ++i) {
+        const string& line = lines[i];
+        const auto colon = line.find(':');
+        const TokenList name = Tokenize(line.substr(0, colon), " \t");
+        if (colon == string::npos || name.size() != 1 || _stricmp(name[0].c_str(), names[i].c_str())) {
+            cerr << "Expected \"" << names[i] << ":\" to start \"" << line << "\"" << endl;
+            return nullopt;
+        }
+        const string rest = line.substr(colon+1);
+        if (i == Waste) {
+            if (!ReadCards(rest, result._waste)) return nullopt;
+        } else if (i < Stock) {
+            const auto bar = rest.find('|');
+            PileVec& pile = result._tableau[i-TableauBase];
+            if (bar == string::npos) {
+                if (Tokenize(rest, " \t\r").size()) {
+                    cerr << "A | must follow the face-down cards in \"" << line << "\"" << endl;
+                    return nullopt;
+                }
+            } else if (!ReadCards(rest.substr(0, bar), pile)) {
+                return nullopt;
+            } else {
+                result._downCount[i-TableauBase] = pile.size();
+                if (!ReadCards(rest.substr(bar+1), pile)) return nullopt;
+            }
+        } else if (i == Stock) {
+            if (!ReadCards(rest, result._stock)) return nullopt;
+        } else if (i < PileCount) {
+            const unsigned suit = i - FoundationBase;
+            PileVec cards;
+            if (!ReadCards(rest, cards)) return nullopt;
+            for (unsigned rank = 0; rank < cards.size(); ++rank) {
+                if (cards[rank] != Card(Card::SuitT(suit), Card::RankT(rank))) {
+                    cerr << "Foundation pile out of order in \"" << line << "\"" << endl;
+                    return nullopt;
+                }
+            }
+            result._foundationSizes[suit] = cards.size();
+        } else {
+            const TokenList count = Tokenize(rest, " \t\r");
+            if (count.size() != 1 || !IsNumber(count[0].c_str()) 
+                    || count[0][0] == '-' || count[0].size() > 3) {
+                cerr << "A number must follow \"rc:\" in \"" << line << "\"" << endl;
+                return nullopt;
+            }
+            result._recycleCount = stoi(count[0]);
+        }
+    }
+    const string error = PositionError(result);
+    if (error.size()) {
+        cerr << error << endl;
+        return nullopt;
+    }
+    return result;
+}
+
 string GameDiagram(const Game& game, unsigned moveNum) {
     stringstream ss;
     string pilestring[]{
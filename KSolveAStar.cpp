@@ -1,8 +1,10 @@
 #include "KSolveAStar.hpp"
 #include "GameStateMemory.hpp"
 #include "MoveStorage.hpp"
+#include "Kernels.hpp"              // Kernels::_misorderCount
 #include <thread>
 #include <atomic>
+#include <bit>                      // countr_zero
 
 namespace KSolveNames {
 
@@ -42,25 +44,65 @@ public:
     bool IsEmpty() const noexcept {return _sol.empty();}
 };
 
-// Counts the number of times a card is higher in the stack
-// than a lower card of the same suit.  Remember that the 
-// stack tops are at the back. For example, if a 4 of hearts
-// is above a 3 of hearts, that is a misorder.
-unsigned MisorderCount(ranges::range auto&& cards) noexcept
+// Replace solution with the moves in movesMade followed by lastMove,
+// if any, and the moves that win the game from there, if that is 
+// shorter.  game must be in the state those moves lead to, and 
+// game.CanAutoComplete() must be true.  count is the length of the
+// whole solution.
+template <class Container>
+static void AutoComplete(CandidateSolution& solution, Game game, 
+        const Container& movesMade, std::optional<MoveSpec> lastMove, 
+        unsigned count) noexcept
+{
+    if (count < solution.MoveCount()) {
+        Moves moves(movesMade.begin(), movesMade.end());
+        if (lastMove) moves.push_back(*lastMove);
+        game.AutoComplete(moves);
+        assert(MoveCount(moves) == count);
+        solution.ReplaceIfShorter(moves, count);
+    }
+}
+
+// The number of cards in stock that will land on a lower card of their
+// suit when drawn, counting only the cards drawn with them
+static unsigned DrawGroupMisorders(const Pile& stock, unsigned draw) noexcept
 {
-    unsigned  minRanks[SuitsPerDeck] {14,14,14,14};
     unsigned result = 0;
-    for (const Card& card: cards){
-        const auto rank = card.Rank();
-        const auto suit = card.Suit();
-        if (rank < minRanks[suit])
-            minRanks[suit] = rank;
-        else
-            result++;
+    for (unsigned top = stock.size(); top > 0; ) {
+        const unsigned bottom = top - std::min(top, draw);
+        CardMask under = 0;
+        for (; top > bottom; --top) {
+            const Card card = stock[top-1];
+            result += (under & LowerCards(card)) != 0;
+            under |= CardMask{1} << card.Value();
+        }
     }
     return result;
 }
 
+// The extra moves MinimumMovesLeft() counts for the talon, given the 
+// number of cards in the waste pile that lie above a lower card of
+// their suit.  Such a card must leave for the tableau before that
+// card can leave, unless the waste pile is recycled first.  Recycling
+// with those cards still there puts at least one more card back in the
+// stock, and drawing them all again takes a move for each draw cards.
+// Once no recycles are left, each such card costs a move, and so does
+// each card in the stock that will land on a lower card of its suit
+// drawn with it.
+//
+// Each term drops by one at most with a move.  A draw only adds to
+// the waste pile's count, and moves the draw's misorders into it.  A
+// recycle, which costs nothing, happens with the stock empty, so the
+// draws it adds to the stock pay for the count it clears.
+template <class R>
+static unsigned TalonMisorders(const Game& game, unsigned draw, unsigned wasteMisorders) noexcept
+{
+    if (!R::RecycleLimited || game.RecycleCount() < game.RecycleLimit()) {
+        return std::min(wasteMisorders, QuotientRoundedUp(wasteMisorders+1, draw));
+    }
+    return wasteMisorders + (draw > 1 ? DrawGroupMisorders(game.StockPile(), draw) : 0);
+}
+
 // Return a lower bound on the number of moves required to complete
 // this game.  This function must return a result that does not 
 // decrease by more than one after any single move.  The sum of 
@@ -75,28 +117,138 @@ unsigned MisorderCount(ranges::range auto&& cards) noexcept
 //		or monotone, if its estimate is always less than or equal 
 //		to the estimated distance from any neighbouring vertex to 
 //		the goal, plus the cost of reaching that neighbour.
-unsigned MinimumMovesLeft(const Game& game) noexcept
+//
+// Besides the misorders within each pile, it counts the moves
+// to the tableau forced by cards in different piles that block each
+// other; see Game::CrossPileBlocks().  heuristic is the set of
+// HeuristicTerms to count.
+//
+// This counts everything from scratch.  Game keeps the tableau counts
+// up to date as moves are made, so MinimumMovesLeft() below need not;
+// it checks its result against this one in debug builds.
+//
+// R is as in Game::AvailableMoves().
+template <class R>
+static unsigned MinimumMovesLeftFromScratch(const Game& game, unsigned heuristic) noexcept
 {
-    const unsigned draw = game.DrawSetting();
+    const unsigned draw = R::Draw ? R::Draw : game.DrawSetting();
     const unsigned talonCount = 
         game.WastePile().size() + game.StockPile().size();
 
     unsigned result = talonCount + QuotientRoundedUp(game.StockPile().size(), draw);
 
-    if (draw == 1) {
-        // This can fail the consistency test for draw setting > 1.
-        result += MisorderCount(game.WastePile());
+    if (heuristic & TalonMisorderTerm) {
+        result += TalonMisorders<R>(game, draw, 
+            game.KernelSet()._misorderCount(game.WastePile(), game.WastePile().size()));
     }
-
     for (const auto & tPile: game.Tableau()) {
         if (tPile.size()) {
             const unsigned downCount = tPile.DownCount();
-            result += tPile.size() + MisorderCount(tPile | views::take(downCount+1));
+            result += tPile.size();
+            if (heuristic & TableauMisorderTerm)
+                result += game.KernelSet()._misorderCount(tPile, downCount+1);
         }
     }
+    if (heuristic & CrossPileTerm) 
+        result += Game::CrossPileBlocks(game.Tableau());
     return result;
 }
 
+// Same as MinimumMovesLeftFromScratch(), given that the tableau holds
+// the cards not in the talon or on the foundation piles.
+template <class R>
+static unsigned MinimumMovesLeft(const Game& game, unsigned heuristic) noexcept
+{
+    const unsigned draw = R::Draw ? R::Draw : game.DrawSetting();
+    const auto& foundation = game.Foundation();
+    const unsigned onFoundation = foundation[0].size() + foundation[1].size()
+                                + foundation[2].size() + foundation[3].size();
+    unsigned result = CardsPerDeck - onFoundation 
+        + QuotientRoundedUp(game.StockPile().size(), draw);
+    if (heuristic & TableauMisorderTerm) 
+        result += game.TableauMisorders();
+    if (heuristic & CrossPileTerm) 
+        result += game.CrossPileBlocks();
+    if (heuristic & TalonMisorderTerm) 
+        result += TalonMisorders<R>(game, draw, game.WasteMisorders());
+    assert(result == MinimumMovesLeftFromScratch<R>(game, heuristic));
+    return result;
+}
+
+unsigned MinimumMovesLeft(const Game& game, unsigned heuristic) noexcept
+{
+    return MinimumMovesLeft<RunTimeRules>(game, heuristic);
+}
+
+// The cards card can be moved onto in the tableau
+static CardMask ParentCards(Card card) noexcept
+{
+    const unsigned otherColor = (card.Suit() & 1) ^ 1;
+    const unsigned rank = card.Rank()+1;
+    return CardMask{1} << (CardsPerSuit*otherColor + rank)
+         | CardMask{1} << (CardsPerSuit*(otherColor+2) + rank);
+}
+
+// Deadlocked() looks for a set of cards none of which can move until
+// another in the set has moved.  It considers only cards that can
+// move only alone or at the bottom of the cards above them: face-down
+// cards and face-up cards not on a card they cover in the tableau,
+// and, once the last recycle is used, every card in the waste pile.
+// Such a card, unless it is a king, can leave only for its foundation
+// pile or for one of its two parents (the cards it can cover), so it
+// is stuck if each of its parents lies beneath a stuck card (perhaps
+// itself), and so does some lower card of its suit, or that card is
+// stuck.  Parents in the stock or on a foundation pile might come to
+// the tableau, so they free it.  It starts with every such card in
+// the set and drops the ones that have a way out until none do.
+//
+// No move puts such a card on top of another card, so only drawing
+// onto an exhausted talon's waste pile can turn a live game into a
+// deadlocked one.
+bool Deadlocked(const Game& game) noexcept
+{
+    using Mask = CardMask;
+    // For each card in the set, the cards under it
+    std::array<Mask,CardsPerDeck> below;
+    Mask inPiles{0};
+    Mask stuck{0};
+    // The first baseCount+1 cards in pile can move only alone.
+    const auto AddPile = [&](const PileVec& pile, unsigned baseCount) {
+        Mask under{0};
+        for (unsigned i = 0; i < pile.size(); ++i) {
+            const Card card = pile[i];
+            if ((i <= baseCount || !card.Covers(pile[i-1])) && card.Rank() != Card::King) {
+                below[card.Value()] = under;
+                stuck |= Mask{1} << card.Value();
+            }
+            under |= Mask{1} << card.Value();
+        }
+        inPiles |= under;
+    };
+    for (const auto& pile: game.Tableau()) {
+        AddPile(pile, pile.DownCount());
+    }
+    if (game.RecycleCount() == game.RecycleLimit()) {
+        AddPile(game.WastePile(), game.WastePile().size());
+    }
+    while (stuck) {
+        Mask buried{0};
+        for (Mask rest = stuck; rest; rest &= rest-1) {
+            buried |= below[std::countr_zero(rest)];
+        }
+        Mask stillStuck = stuck;
+        for (Mask rest = stuck; rest; rest &= rest-1) {
+            const Card card(std::countr_zero(rest));
+            const Mask parents = ParentCards(card);
+            if (!(LowerCards(card) & (stuck | buried)) || (parents & buried) != parents)
+                stillStuck &= ~(Mask{1} << card.Value());
+        }
+        if (stillStuck == stuck) break;
+        stuck = stillStuck;
+    }
+    return stuck != 0;
+}
+
 using AtomicUInt = std::atomic_uint;
 
 struct WorkerState {
@@ -116,17 +268,25 @@ public:
     GameStateMemory& _closedList;
     CandidateSolution & _minSolution;
     AtomicUInt& _advances;
+    // Set if the talon look-ahead limit hid a card from any thread
+    std::atomic_bool& _talonLookAheadCut;
+    // The HeuristicTerms MinimumMovesLeft() counts
+    const unsigned _heuristic;
 
     explicit WorkerState(  Game & gm, 
             CandidateSolution& solution,
             SharedMoveStorage& sharedMoveStorage,
             GameStateMemory& closed,
-            AtomicUInt& loopCount)
+            AtomicUInt& loopCount,
+            std::atomic_bool& talonLookAheadCut,
+            unsigned heuristic)
         : _game(gm)
         , _moveStorage(sharedMoveStorage)
         , _closedList(closed)
         , _minSolution(solution)
         , _advances(loopCount)
+        , _talonLookAheadCut(talonLookAheadCut)
+        , _heuristic(heuristic)
         {}
     explicit WorkerState(const WorkerState& orig)
         : _game(orig._game)
@@ -134,8 +294,14 @@ public:
         , _closedList(orig._closedList)
         , _minSolution(orig._minSolution)
         , _advances(orig._advances)
-        {}
+        , _talonLookAheadCut(orig._talonLookAheadCut)
+        , _heuristic(orig._heuristic)
+        {
+            // The new _moveStorage has an empty move sequence
+            _game.Deal();
+        }
             
+    template <class R>
     QMoves MakeAutoMoves() noexcept;
 };
 
@@ -143,11 +309,21 @@ public:
 // encountered. If more than one dominant move is available
 // (as when two aces are dealt face up), AvailableMoves() will
 // return them one at a time.
+template <class R>
 QMoves WorkerState::MakeAutoMoves() noexcept
 {
     QMoves availableMoves;
+    // Without XYZ_Filter(), stem moves could go around in a circle
+    // (as to and from a foundation pile), so make none and let the
+    // closed list catch repeated states.  Any dominant moves left in
+    // the cache would be stale by the time this state is revisited.
+    if constexpr (!R::Prunes(PruneXYZ)) {
+        availableMoves = _game.AvailableMoves<R>(_moveStorage.MoveSequence());
+        _game.ClearMoveCache();
+        return availableMoves;
+    }
     while ((availableMoves = 
-        _game.AvailableMoves(_moveStorage.MoveSequence())).size() == 1)
+        _game.AvailableMoves<R>(_moveStorage.MoveSequence())).size() == 1)
     {
         _moveStorage.PushStem(availableMoves[0]);
         _game.MakeMove(availableMoves[0]);
@@ -157,6 +333,11 @@ QMoves WorkerState::MakeAutoMoves() noexcept
 // *Advance()* starts from a game state and grows the tree to the next
 // branching node.  It then pushes each qualifying child of that branching
 // node into the work queue.
+//
+// Advance() and the functions that call it are templates on a Rules
+// type so that the hot loop is compiled for the game's draw setting 
+// and recycle limit.  KSolveAStar() chooses one.
+template <class R>
 inline static void Advance(
         WorkerState& state,
         unsigned minMoves0) noexcept
@@ -169,7 +350,7 @@ inline static void Advance(
 
     // Make all the no-choice (stem) moves.  Returns the first choice of moves
     // (the branches from next branching node) or an empty set.
-    const QMoves availableMoves = state.MakeAutoMoves();
+    const QMoves availableMoves = state.MakeAutoMoves<R>();
 
     const unsigned movesMadeCount = 
         moveStorage.MoveSequence().MoveCount();
@@ -181,6 +362,10 @@ inline static void Advance(
             minSolution.ReplaceIfShorter(
                 moveStorage.MoveSequence(), movesMadeCount);
         }
+    } else if (game.CanAutoComplete()) {
+        // Win now rather than one move at a time through the fringe
+        AutoComplete(minSolution, game, moveStorage.MoveSequence(), std::nullopt,
+            movesMadeCount + MinimumMovesLeft<R>(game, state._heuristic));
     } else {
         // Save the result of each of the possible next moves.
         for (const auto mv: availableMoves){
@@ -190,23 +375,38 @@ inline static void Advance(
 
             if (closedList.IsShortPathToState(game, made))
             { 
-                unsigned minRemaining = MinimumMovesLeft(game); 
+                unsigned minRemaining = MinimumMovesLeft<R>(game, state._heuristic);
                 const unsigned minMoves = made + minRemaining;
                 assert(minMoves0 <= minMoves);  // consistency test
                 
-                if (minMoves < minSolution.MoveCount())
+                if (minMoves >= minSolution.MoveCount()) {
+                    // Cannot improve on the best solution
+                } else if (game.CanAutoComplete()) {
+                    // minMoves is exact, so this child need not wait
+                    // in the fringe.
+                    AutoComplete(minSolution, game, moveStorage.MoveSequence(), mv, minMoves);
+                } else if (R::Prunes(PruneDeadEnds) && R::RecycleLimited 
+                        && mv.IsStockMove()
+                        && game.RecycleCount() == game.RecycleLimit()
+                        && Deadlocked(game)) {
+                    // No solution grows from this child.  Only drawing 
+                    // onto the waste pile with no recycles left can
+                    // deadlock a game that was not (see Deadlocked()).
+                } else {
                     moveStorage.PushBranch(mv,minMoves);
+                }
             }
             game.UnMakeMove(mv);
         }
         // Update shared data structures with the moves made here
-        moveStorage.ShareMoves();
+        moveStorage.ShareMoves(minMoves0);
     }
 }
 
 /*************************************************************************/
 /*************************** Main Loop ***********************************/
 /*************************************************************************/
+template <class R>
 static void Worker(
         WorkerState* pMasterState) noexcept
 {
@@ -224,17 +424,23 @@ static void Worker(
             && minMoves0 < minSolution.MoveCount())
     {
         ++myLoopCount;
-        Advance(state, minMoves0);
+        Advance<R>(state, minMoves0);
     }
     state._advances += myLoopCount;
+    if (game.TalonLookAheadCut())
+        state._talonLookAheadCut = true;
+#ifdef KSOLVE_RESTORE_CACHE
+    moveStorage.ShareRestoreCacheCounts();
+#endif
     return;
 }
 
+template <class R>
 static void RunWorkers(unsigned nThreads, WorkerState & state) noexcept
 {
     // Put some work in the work queue by growing the tree from
     // the root to the first branching node.
-    Advance(state, state._moveStorage.Shared().InitialMinMoves());
+    Advance<R>(state, state._moveStorage.Shared().InitialMinMoves());
     state._moveStorage.Flush();
 
     if (nThreads == 0)
@@ -244,38 +450,96 @@ static void RunWorkers(unsigned nThreads, WorkerState & state) noexcept
     std::vector<std::thread> threads;
     threads.reserve(nThreads-1);
     for (unsigned t = 0; t < nThreads-1; ++t) {
-        threads.emplace_back(&Worker, &state);
+        threads.emplace_back(&Worker<R>, &state);
     }
 
     // Run one more worker in this (main) thread
-    Worker(&state);
+    Worker<R>(&state);
 
     for (auto& thread: threads) 
         thread.join();
     // Everybody's finished
 }
+
+template <unsigned Draw>
+static void RunWorkersForDraw(unsigned nThreads, WorkerState & state) noexcept
+{
+    if (state._game.RecycleLimited())
+        RunWorkers<Rules<Draw,true>>(nThreads, state);
+    else
+        RunWorkers<Rules<Draw,false>>(nThreads, state);
+}
+
+// Run the workers with all the pruning rules but one, for
+// testing that rule.  These are compiled for any draw setting.
+template <PruneRule Disabled>
+static void RunWorkersWithout(unsigned nThreads, WorkerState & state) noexcept
+{
+    RunWorkers<Rules<0,true,PruneAll & ~Disabled>>(nThreads, state);
+}
+
+// Run the workers compiled for the game's rules.  Game.cpp must
+// instantiate Game::AvailableMoves() for each Rules type used here.
+static void RunWorkersForRules(unsigned nThreads, WorkerState & state, 
+                               unsigned disabledPruneRule) noexcept
+{
+    switch (disabledPruneRule) {
+        case 0: break;
+        case PruneDominant:         RunWorkersWithout<PruneDominant>(nThreads, state); return;
+        case PruneReverseDominant:  RunWorkersWithout<PruneReverseDominant>(nThreads, state); return;
+        case PruneXYZ:              RunWorkersWithout<PruneXYZ>(nThreads, state); return;
+        case PruneKingOnce:         RunWorkersWithout<PruneKingOnce>(nThreads, state); return;
+        case PruneKingSpace:        RunWorkersWithout<PruneKingSpace>(nThreads, state); return;
+        case PruneDeadEnds:         RunWorkersWithout<PruneDeadEnds>(nThreads, state); return;
+        default: assert(!"disabledPruneRule must be 0 or one PruneRule");
+    }
+    switch (state._game.DrawSetting()) {
+        case 1:  RunWorkersForDraw<1>(nThreads, state); break;
+        case 3:  RunWorkersForDraw<3>(nThreads, state); break;
+        default: RunWorkersForDraw<0>(nThreads, state); break;
+    }
+}
 /*************************************************************************/
 /*************************** Entrance ************************************/
 /*************************************************************************/
 KSolveAStarResult KSolveAStar(
         Game& game,
         unsigned moveTreeLimit,
-        unsigned nThreads) noexcept
+        unsigned nThreads,
+        const std::string& moveTreeDirectory,
+        unsigned talonLookAhead,
+        unsigned disabledPruneRule,
+        unsigned heuristic) noexcept
 {
     GameStateMemory closed;
     CandidateSolution solution;
     AtomicUInt loopCount{0};
+    std::atomic_bool talonLookAheadCut{false};
 
-    const unsigned startMoves = MinimumMovesLeft(game);
-    SharedMoveStorage sharedMoveStorage(moveTreeLimit, startMoves);
+    const unsigned startMoves = MinimumMovesLeft(game, heuristic);
+    // The cross-pile costs for this deal, shared read-only by every 
+    // thread's copy of the game
+    const Game::CrossPileCosts crossPileCosts = game.MakeCrossPileCosts();
+    SharedMoveStorage sharedMoveStorage(moveTreeLimit, startMoves, moveTreeDirectory);
 
-    WorkerState state(game,solution,sharedMoveStorage,closed,loopCount);
+    WorkerState state(game,solution,sharedMoveStorage,closed,loopCount,
+                      talonLookAheadCut,heuristic);
+    state._game.SetTalonLookAhead(talonLookAhead);
+    state._game.UseCrossPileCosts(&crossPileCosts);
 
-    RunWorkers(nThreads, state);
+    // A deal that starts deadlocked needs no search, nor
+    // does a position that has already been won.
+    const bool won = state._game.GameOver();
+    if (!won && (disabledPruneRule == PruneDeadEnds || !Deadlocked(state._game)))
+        RunWorkersForRules(nThreads, state, disabledPruneRule);
     
-    bool overLimit = sharedMoveStorage.OverLimit();
+    // A search that could not see every talon card is no more
+    // conclusive than one that ran out of room.
+    bool overLimit = sharedMoveStorage.OverLimit()
+                || talonLookAheadCut
+                || state._game.TalonLookAheadCut();
     KSolveAStarCode outcome;
-    if (solution.GetMoves().size()) { 
+    if (solution.GetMoves().size() || won) { 
         outcome = overLimit
                 ? Solved
                 : SolvedMinimal;
@@ -284,7 +548,7 @@ KSolveAStarResult KSolveAStar(
                 ? GaveUp
                 : Impossible;
     }
-    return KSolveAStarResult(
+    KSolveAStarResult result(
         outcome,
         solution.GetMoves(),
         state._closedList.Size(),
@@ -292,6 +556,12 @@ KSolveAStarResult KSolveAStar(
         sharedMoveStorage.FringeSize(),
         loopCount
     );
+#ifdef KSOLVE_RESTORE_CACHE
+    result._restoreCacheHits = sharedMoveStorage.RestoreCacheHits();
+    result._restoreCacheMisses = sharedMoveStorage.RestoreCacheMisses();
+#endif
+    result._moveTreeMapped = sharedMoveStorage.IsMapped();
+    return result;
 }
 
 }   // namespace KSolveNames
\ No newline at end of file
@@ -28,6 +28,22 @@
 
 #include "Game.hpp"		// for Game, Card, Pile, Move etc.
 namespace KSolveNames {
+// The terms MinimumMovesLeft() can add to its count of one move for each
+// card not on a foundation pile and one for each draw the stock needs.
+// A heuristic policy is a set of them.  Each set gives a consistent
+// heuristic, so KSolveAStar() finds minimum solutions with any of them;
+// leaving terms out only makes it search more.
+enum HeuristicTerm : unsigned
+{
+    TableauMisorderTerm = 1,    // see Game::TableauMisorders()
+    CrossPileTerm = 2,          // see Game::CrossPileBlocks()
+    TalonMisorderTerm = 4,      // waste pile and draw group misorders
+    FullHeuristic = 7
+};
+// HeuristicTerm names for messages, in bit order
+constexpr std::array<const char*,3> HeuristicTermNames
+    {"tableau", "cross-pile", "talon"};
+
 // Solves the game of Klondike Solitaire for minimum moves if possible.
 // Returns a result code and a Moves vector and some statistics. 
 // The vector contains the minimum solution if the code returned
@@ -38,6 +54,20 @@ namespace KSolveNames {
 //
 // This function uses an unpredictable amount of main memory. You can
 // control this behavior to some degree by specifying MoveTreeLimit. 
+// Where the operating system supports it, you can also move the move
+// tree, usually the largest structure, out to a file by specifying
+// moveTreeDirectory.  The operating system can then page it out as
+// needed.
+//
+// Specifying talonLookAhead less than MaxTalonLookAhead makes the
+// search consider playing only the first talonLookAhead cards
+// reachable by drawing from the talon at each step.  That usually makes
+// it faster, but if the limit ever hides a card, the result code
+// becomes Solved rather than SolvedMinimal, or GaveUp rather than
+// Impossible.
+//
+// heuristic is the set of HeuristicTerms the search's lower bound on
+// the moves left adds up, for comparing them.
 //
 // The statistics returns are:
 //
@@ -60,6 +90,17 @@ namespace KSolveNames {
 //      closed list, and if it qualifies, pushes it to the fringe. The starting
 //      move spec and each move spec that does not have siblings is moved to the
 //      move tree.
+//
+//      _restoreCacheHits and _restoreCacheMisses, in builds with
+//      KSOLVE_RESTORE_CACHE defined, count the trips that could not 
+//      simply extend the current move sequence and did or did not find
+//      a snapshot of the game state at one of the new stems in their
+//      thread's restore cache.
+//
+//      _moveTreeMapped is true if the move tree was kept in a file in
+//      moveTreeDirectory, and false if it was kept in main memory, 
+//      either because no directory was given or because no file could
+//      be mapped there.
 
 enum KSolveAStarCode {SolvedMinimal, Solved, Impossible, GaveUp};
 
@@ -72,6 +113,11 @@ public:
     unsigned _moveTreeSize{0};
     unsigned _finalFringeSize{0};
     unsigned _advances;
+#ifdef KSOLVE_RESTORE_CACHE
+    unsigned _restoreCacheHits{0};
+    unsigned _restoreCacheMisses{0};
+#endif
+    bool _moveTreeMapped{false};
 
     KSolveAStarResult(KSolveAStarCode code, 
                 const Moves& moves, 
@@ -91,11 +137,31 @@ KSolveAStarResult KSolveAStar(
         Game& gm, 			// The game to be played
         unsigned moveTreeLimit=12'000'000,// Give up if the size of the move tree
                                         // exceeds this.
-        unsigned threads=0) noexcept;   // Use as many threads as the hardware will run concurrently
+        unsigned threads=0,             // Use as many threads as the hardware will run concurrently
+        const std::string& moveTreeDirectory="",
+                                        // If not empty, keep the move tree in a
+                                        // temporary memory-mapped file in this
+                                        // directory rather than in main memory.
+        unsigned talonLookAhead=MaxTalonLookAhead,
+                                        // Consider playing only this many
+                                        // talon cards at each step (1 to 24).
+        unsigned disabledPruneRule=0,
+                                        // 0 or one PruneRule (see Game.hpp) 
+                                        // to leave out, for testing it.
+                                        // Slower for any other value than 0.
+        unsigned heuristic=FullHeuristic) noexcept;
+                                        // The HeuristicTerms to count
 
 unsigned DefaultThreads() noexcept;
 
-unsigned MinimumMovesLeft(const Game& game) noexcept;
+unsigned MinimumMovesLeft(const Game& game, unsigned heuristic=FullHeuristic) noexcept;
+
+// Return true if some tableau cards block each other so that none 
+// of them can ever move, which means the game cannot be won.  
+// A card blocks another if it lies on top of a lower card of the 
+// other's suit or on top of one of the cards the other could be 
+// moved onto.  False does not mean the game can be won.
+bool Deadlocked(const Game& game) noexcept;
 }       // namespace KSolveNames
 
 
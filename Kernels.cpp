@@ -0,0 +1,368 @@
+// Kernels.cpp implements the kernels declared in Kernels.hpp.
+
+#include "Kernels.hpp"
+#include <cstring>          // memcpy
+#include <bit>              // popcount
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KSOLVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace KSolveNames {
+
+/*************************************************************************/
+/*************************** Scalar **************************************/
+/*************************************************************************/
+static void SortTableauCodesScalar(const TableauCodeArray& codes, TableauCodeArray& sorted) noexcept
+{
+    sorted = codes;
+    ranges::sort(sorted);
+}
+
+static unsigned MajorSuitBitsScalar(const PileVec& pile, unsigned first, unsigned n) noexcept
+{
+    unsigned isMajor{0};
+    for (Card card : pile | views::drop(first) | views::take(n)) {
+        isMajor <<= 1;
+        isMajor |= card.IsMajor();
+    }
+    return isMajor;
+}
+
+// Counts the number of times a card is higher in the stack
+// than a lower card of the same suit.  Remember that the
+// stack tops are at the back. For example, if a 4 of hearts
+// is above a 3 of hearts, that is a misorder.
+static unsigned MisorderCountScalar(const PileVec& pile, unsigned n) noexcept
+{
+    unsigned  minRanks[SuitsPerDeck] {14,14,14,14};
+    unsigned result = 0;
+    for (const Card& card: pile | views::take(n)){
+        const auto rank = card.Rank();
+        const auto suit = card.Suit();
+        if (rank < minRanks[suit])
+            minRanks[suit] = rank;
+        else
+            result++;
+    }
+    return result;
+}
+
+#ifdef KSOLVE_X86_KERNELS
+// The vector kernels load up to 24 bytes from a PileVec's data(), 
+// whatever its size().
+template <class V> struct CapacityOf;
+template <class T, unsigned C> struct CapacityOf<static_vector<T,C>>
+{
+    static constexpr unsigned value = C;
+};
+static_assert(CapacityOf<PileVec>::value*sizeof(Card) >= 24,
+    "The vector kernels read 24 bytes from a PileVec");
+
+// The vector kernels read a Card as the byte rank<<4 | suit.
+// AvailableKernels() checks that before offering them.
+static bool CardLayoutIsAsExpected() noexcept
+{
+    const Card card(Card::Spades, Card::RankT(5));
+    unsigned char byte;
+    std::memcpy(&byte, &card, 1);
+    return sizeof(Card) == 1 && byte == (5<<4 | Card::Spades);
+}
+
+/*************************************************************************/
+/*************************** SSE4.2 **************************************/
+/*************************************************************************/
+
+// The codes are sorted by the 19-comparator network for eight
+// elements (Knuth, TAOCP vol. 3, 5.3.4), with a largest value in
+// the eighth place.  Lanes 0-3 are in a, 4-7 in b.  Each step
+// compares pairs of lanes, leaving the minimum in the lower one.
+#define KSOLVE_SSE __attribute__((target("sse4.2")))
+
+// Compare lane i with lane i^2 in each register
+KSOLVE_SSE static inline __m128i CompareHalves(__m128i x) noexcept
+{
+    const __m128i p = _mm_shuffle_epi32(x, 0x4e);
+    return _mm_blend_epi16(_mm_min_epu32(x,p), _mm_max_epu32(x,p), 0xf0);
+}
+// Compare lane i with lane i^1
+KSOLVE_SSE static inline __m128i CompareNeighbors(__m128i x) noexcept
+{
+    const __m128i p = _mm_shuffle_epi32(x, 0xb1);
+    return _mm_blend_epi16(_mm_min_epu32(x,p), _mm_max_epu32(x,p), 0xcc);
+}
+
+// Load the seven codes into lanes 0-6, with UINT32_MAX in lane 7.
+// Loading and storing them in overlapping halves instead of through 
+// a padded array avoids stalls forwarding the stores to the loads.
+KSOLVE_SSE static inline void LoadCodes(const TableauCodeArray& codes, __m128i& a, __m128i& b) noexcept
+{
+    a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes.data()));
+    b = _mm_alignr_epi8(_mm_set1_epi32(-1),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes.data()+3)), 4);
+}
+KSOLVE_SSE static inline void StoreCodes(TableauCodeArray& codes, __m128i a, __m128i b) noexcept
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(codes.data()+3), _mm_alignr_epi8(b, a, 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(codes.data()), a);
+}
+
+KSOLVE_SSE static void SortTableauCodesSse(const TableauCodeArray& codes, TableauCodeArray& sorted) noexcept
+{
+    __m128i a, b;
+    LoadCodes(codes, a, b);
+    // (0,2) (1,3) (4,6) (5,7)
+    a = CompareHalves(a);
+    b = CompareHalves(b);
+    // (0,4) (1,5) (2,6) (3,7)
+    __m128i t = _mm_min_epu32(a,b);
+    b = _mm_max_epu32(a,b);
+    a = t;
+    // (0,1) (2,3) (4,5) (6,7)
+    a = CompareNeighbors(a);
+    b = CompareNeighbors(b);
+    // (2,4) (3,5)
+    t = CompareHalves(_mm_alignr_epi8(b, a, 8));            // a2 a3 b0 b1
+    a = _mm_unpacklo_epi64(a, t);
+    b = _mm_unpackhi_epi64(t, b);
+    // (1,4) (3,6)
+    t = CompareHalves(_mm_castps_si128(_mm_shuffle_ps(     // a1 a3 b0 b2
+            _mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2,0,3,1))));
+    a = _mm_blend_epi16(a, _mm_shuffle_epi32(t, _MM_SHUFFLE(1,1,0,0)), 0xcc);
+    b = _mm_blend_epi16(_mm_shuffle_epi32(t, _MM_SHUFFLE(3,3,2,2)), b, 0xcc);
+    // (1,2) (3,4) (5,6)
+    t = CompareNeighbors(_mm_alignr_epi8(b, a, 4));         // a1 a2 a3 b0
+    const __m128i u =
+        CompareNeighbors(_mm_shuffle_epi32(b, _MM_SHUFFLE(3,3,2,1))); // b1 b2 b3 b3
+    a = _mm_blend_epi16(_mm_slli_si128(t, 4), a, 0x03);
+    b = _mm_alignr_epi8(u, t, 12);
+    StoreCodes(sorted, a, b);
+}
+
+// Reverse the n cards so the last is in lane 0, then collect the
+// suits' high bits with one movemask.
+KSOLVE_SSE static unsigned MajorSuitBitsSse(const PileVec& pile, unsigned first, unsigned n) noexcept
+{
+    assert(first <= 8 && n <= 16);
+    // Cards past the end of the pile are in the same array
+    const __m128i cards = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pile.data()+first));
+    // Lane k selects card n-1-k, or zero if that is negative
+    const __m128i reverse = _mm_add_epi8(
+        _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0),
+        _mm_set1_epi8(char(n-16)));
+    const __m128i reversed = _mm_shuffle_epi8(cards, reverse);
+    // Move bit 1 (IsMajor()) of each byte to bit 7
+    return _mm_movemask_epi8(_mm_slli_epi16(reversed, 6));
+}
+
+// For each suit, a running maximum of 0x7f-rank over the earlier
+// cards of that suit.  A card is a misorder if its own 0x7f-rank is
+// less.  Zero stands for no earlier card.
+KSOLVE_SSE static inline __m128i PrefixMax(__m128i x) noexcept
+{
+    x = _mm_max_epu8(x, _mm_slli_si128(x, 1));
+    x = _mm_max_epu8(x, _mm_slli_si128(x, 2));
+    x = _mm_max_epu8(x, _mm_slli_si128(x, 4));
+    return _mm_max_epu8(x, _mm_slli_si128(x, 8));
+}
+// For up to eight cards, compare every card with every earlier one
+// instead.  Each register holds two rows of an 8x8 matrix: in row j,
+// lane i is set if card i comes before card j and is a lower card of
+// the same suit.  Card j is a misorder if any lane in its row is set.
+// The cards' high bits are flipped so signed comparisons order them.
+KSOLVE_SSE static inline unsigned MisorderRowsSse(__m128i cards, __m128i rows) noexcept
+{
+    const __m128i later = _mm_shuffle_epi8(cards, rows);
+    const __m128i earlier = _mm_shuffle_epi8(cards, 
+        _mm_setr_epi8(0,1,2,3,4,5,6,7,0,1,2,3,4,5,6,7));
+    const __m128i sameSuit = _mm_cmpeq_epi8(_mm_setzero_si128(),
+        _mm_and_si128(_mm_xor_si128(later, earlier), _mm_set1_epi8(0x0f)));
+    return _mm_movemask_epi8(_mm_and_si128(sameSuit, _mm_cmpgt_epi8(later, earlier)));
+}
+// Count the rows of matrix, one byte per row, that have any bit set
+// for an earlier card among the first n.
+static inline unsigned MisorderedRows(uint64_t matrix, unsigned n) noexcept
+{
+    const uint64_t earlier = 0x7f3f1f0f07030100;    // in row j, bits 0 to j-1
+    const uint64_t low7 = 0x7f7f7f7f7f7f7f7f;
+    matrix &= earlier;
+    if (n < 8) matrix &= (uint64_t{1} << 8*n) - 1;
+    // Set the high bit of each nonzero byte
+    matrix = ((matrix & low7) + low7) | matrix;
+    return std::popcount(matrix & ~low7);
+}
+KSOLVE_SSE static unsigned MisorderCountSmallSse(const PileVec& pile, unsigned n) noexcept
+{
+    assert(n <= 8);
+    const __m128i cards = _mm_xor_si128(_mm_set1_epi8(char(0x80)),
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pile.data())));
+    const uint64_t matrix = 
+                 uint64_t(MisorderRowsSse(cards, _mm_setr_epi8(0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1)))
+        |        uint64_t(MisorderRowsSse(cards, _mm_setr_epi8(2,2,2,2,2,2,2,2,3,3,3,3,3,3,3,3))) << 16
+        |        uint64_t(MisorderRowsSse(cards, _mm_setr_epi8(4,4,4,4,4,4,4,4,5,5,5,5,5,5,5,5))) << 32
+        |        uint64_t(MisorderRowsSse(cards, _mm_setr_epi8(6,6,6,6,6,6,6,6,7,7,7,7,7,7,7,7))) << 48;
+    return MisorderedRows(matrix, n);
+}
+KSOLVE_SSE static unsigned MisorderCountSse(const PileVec& pile, unsigned n) noexcept
+{
+    if (n <= 8) return MisorderCountSmallSse(pile, n);
+
+    // Reads all 24 places in the pile
+    assert(n <= 24);
+    const __m128i lowNibble = _mm_set1_epi8(0x0f);
+    const __m128i cards0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pile.data()));
+    const __m128i cards1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pile.data()+16));
+    const __m128i lane = _mm_setr_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+    const __m128i valid0 = _mm_cmpgt_epi8(_mm_set1_epi8(char(n)), lane);
+    const __m128i valid1 = _mm_cmpgt_epi8(_mm_set1_epi8(char(n-16)), lane);
+    const __m128i suit0 = _mm_and_si128(cards0, lowNibble);
+    const __m128i suit1 = _mm_and_si128(cards1, lowNibble);
+    const __m128i x7f = _mm_set1_epi8(0x7f);
+    const __m128i w0 = _mm_and_si128(valid0,
+        _mm_sub_epi8(x7f, _mm_and_si128(_mm_srli_epi16(cards0, 4), lowNibble)));
+    const __m128i w1 = _mm_and_si128(valid1,
+        _mm_sub_epi8(x7f, _mm_and_si128(_mm_srli_epi16(cards1, 4), lowNibble)));
+
+    __m128i before0 = _mm_setzero_si128();
+    __m128i before1 = _mm_setzero_si128();
+    for (int suit = 0; suit < int(SuitsPerDeck); ++suit) {
+        const __m128i inSuit0 = _mm_cmpeq_epi8(suit0, _mm_set1_epi8(char(suit)));
+        const __m128i all0 = PrefixMax(_mm_and_si128(w0, inSuit0));
+        before0 = _mm_or_si128(before0, _mm_and_si128(inSuit0, _mm_slli_si128(all0, 1)));
+        if (n > 16) {
+            const __m128i inSuit1 = _mm_cmpeq_epi8(suit1, _mm_set1_epi8(char(suit)));
+            const __m128i all1 = _mm_max_epu8(PrefixMax(_mm_and_si128(w1, inSuit1)),
+                    _mm_shuffle_epi8(all0, _mm_set1_epi8(15)));
+            before1 = _mm_or_si128(before1, _mm_and_si128(inSuit1, _mm_alignr_epi8(all1, all0, 15)));
+        }
+    }
+    // Lanes past the n cards may have compared true
+    const unsigned misordered =
+            _mm_movemask_epi8(_mm_cmpgt_epi8(before0, w0))
+        |   _mm_movemask_epi8(_mm_cmpgt_epi8(before1, w1)) << 16;
+    return std::popcount(misordered & ((1U<<n) - 1));
+}
+#undef KSOLVE_SSE
+
+/*************************************************************************/
+/*************************** AVX2 ****************************************/
+/*************************************************************************/
+#define KSOLVE_AVX2 __attribute__((target("avx2")))
+
+// Compare each lane with the one perm gives, leaving the maximum
+// in the lanes in mask
+#define KSOLVE_COMPARE(v, p0,p1,p2,p3,p4,p5,p6,p7, mask)                    \
+    {                                                                       \
+        const __m256i p = _mm256_permutevar8x32_epi32(v,                    \
+            _mm256_setr_epi32(p0,p1,p2,p3,p4,p5,p6,p7));                    \
+        v = _mm256_blend_epi32(_mm256_min_epu32(v,p), _mm256_max_epu32(v,p), mask); \
+    }
+
+KSOLVE_AVX2 static void SortTableauCodesAvx2(const TableauCodeArray& codes, TableauCodeArray& sorted) noexcept
+{
+    __m128i a, b;
+    LoadCodes(codes, a, b);
+    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+    KSOLVE_COMPARE(v, 2,3,0,1,6,7,4,5, 0xcc)    // (0,2) (1,3) (4,6) (5,7)
+    KSOLVE_COMPARE(v, 4,5,6,7,0,1,2,3, 0xf0)    // (0,4) (1,5) (2,6) (3,7)
+    KSOLVE_COMPARE(v, 1,0,3,2,5,4,7,6, 0xaa)    // (0,1) (2,3) (4,5) (6,7)
+    KSOLVE_COMPARE(v, 0,1,4,5,2,3,6,7, 0x30)    // (2,4) (3,5)
+    KSOLVE_COMPARE(v, 0,4,2,6,1,5,3,7, 0x50)    // (1,4) (3,6)
+    KSOLVE_COMPARE(v, 0,2,1,4,3,6,5,7, 0x54)    // (1,2) (3,4) (5,6)
+    StoreCodes(sorted, _mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+#undef KSOLVE_COMPARE
+
+// Shift x left by n bytes across the two 128-bit halves
+#define KSOLVE_SHIFT_LEFT(x, n) \
+    _mm256_alignr_epi8(x, _mm256_permute2x128_si256(x, x, 0x08), 16-(n))
+
+// As MisorderCountSse(), with all 24 cards in one register
+KSOLVE_AVX2 static unsigned MisorderCountAvx2(const PileVec& pile, unsigned n) noexcept
+{
+    assert(n <= 24);
+    if (n <= 8) {
+        // Four rows of the matrix in each register
+        const __m256i cards = _mm256_broadcastsi128_si256(_mm_xor_si128(_mm_set1_epi8(char(0x80)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pile.data()))));
+        const __m256i earlier = _mm256_shuffle_epi8(cards, _mm256_setr_epi8(
+            0,1,2,3,4,5,6,7,0,1,2,3,4,5,6,7, 0,1,2,3,4,5,6,7,0,1,2,3,4,5,6,7));
+        auto rows = [&](__m256i index) KSOLVE_AVX2 {
+            const __m256i later = _mm256_shuffle_epi8(cards, index);
+            const __m256i sameSuit = _mm256_cmpeq_epi8(_mm256_setzero_si256(),
+                _mm256_and_si256(_mm256_xor_si256(later, earlier), _mm256_set1_epi8(0x0f)));
+            return uint32_t(_mm256_movemask_epi8(
+                _mm256_and_si256(sameSuit, _mm256_cmpgt_epi8(later, earlier))));
+        };
+        const uint64_t matrix = 
+                uint64_t(rows(_mm256_setr_epi8(0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,
+                                                2,2,2,2,2,2,2,2,3,3,3,3,3,3,3,3)))
+            |   uint64_t(rows(_mm256_setr_epi8(4,4,4,4,4,4,4,4,5,5,5,5,5,5,5,5,
+                                                6,6,6,6,6,6,6,6,7,7,7,7,7,7,7,7))) << 32;
+        return MisorderedRows(matrix, n);
+    }
+    if (n <= 16) return MisorderCountSse(pile, n);
+    const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+    const __m256i cards = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pile.data()))),
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pile.data()+16)), 1);
+    const __m256i lane = _mm256_setr_epi8(
+         0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15,
+        16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31);
+    const __m256i valid = _mm256_cmpgt_epi8(_mm256_set1_epi8(char(n)), lane);
+    const __m256i suits = _mm256_and_si256(cards, lowNibble);
+    const __m256i w = _mm256_and_si256(valid, _mm256_sub_epi8(_mm256_set1_epi8(0x7f),
+            _mm256_and_si256(_mm256_srli_epi16(cards, 4), lowNibble)));
+    __m256i before = _mm256_setzero_si256();
+    for (int suit = 0; suit < int(SuitsPerDeck); ++suit) {
+        const __m256i inSuit = _mm256_cmpeq_epi8(suits, _mm256_set1_epi8(char(suit)));
+        __m256i x = _mm256_and_si256(w, inSuit);
+        x = _mm256_max_epu8(x, KSOLVE_SHIFT_LEFT(x, 1));
+        x = _mm256_max_epu8(x, KSOLVE_SHIFT_LEFT(x, 2));
+        x = _mm256_max_epu8(x, KSOLVE_SHIFT_LEFT(x, 4));
+        x = _mm256_max_epu8(x, KSOLVE_SHIFT_LEFT(x, 8));
+        x = _mm256_max_epu8(x, _mm256_permute2x128_si256(x, x, 0x08));
+        before = _mm256_or_si256(before, _mm256_and_si256(inSuit, KSOLVE_SHIFT_LEFT(x, 1)));
+    }
+    const unsigned misordered = _mm256_movemask_epi8(_mm256_cmpgt_epi8(before, w));
+    return std::popcount(misordered & ((1U<<n) - 1));
+}
+#undef KSOLVE_SHIFT_LEFT
+#undef KSOLVE_AVX2
+#endif  // KSOLVE_X86_KERNELS
+
+static const Kernels ScalarKernels {
+    "scalar", SortTableauCodesScalar, MajorSuitBitsScalar, MisorderCountScalar
+};
+#ifdef KSOLVE_X86_KERNELS
+static const Kernels SseKernels {
+    "sse4.2", SortTableauCodesSse, MajorSuitBitsSse, MisorderCountSse
+};
+// Twelve cards fit in one SSE register, so the major-suit bits
+// gain nothing from AVX2.
+static const Kernels Avx2Kernels {
+    "avx2", SortTableauCodesAvx2, MajorSuitBitsSse, MisorderCountAvx2
+};
+#endif
+
+static_vector<const Kernels*,3> AvailableKernels() noexcept
+{
+    static_vector<const Kernels*,3> result{&ScalarKernels};
+#ifdef KSOLVE_X86_KERNELS
+    if (CardLayoutIsAsExpected()) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.2")) result.push_back(&SseKernels);
+        if (__builtin_cpu_supports("avx2"))   result.push_back(&Avx2Kernels);
+    }
+#endif
+    return result;
+}
+
+const Kernels& BestKernels() noexcept
+{
+    const Kernels* result = &ScalarKernels;
+    for (const Kernels* kernels: AvailableKernels()) result = kernels;
+    return *result;
+}
+}   // namespace KSolveNames
@@ -0,0 +1,46 @@
+// Kernels.hpp declares small functions the solver runs for every
+// child it generates: sorting the tableau codes for a GameState,
+// gathering the major-suit bits of a tableau pile's face-up cards for
+// its code, and counting the misorders MinimumMovesLeft() adds up.
+//
+// Each has a scalar version and, on x86 with GCC or Clang, SSE4.2 and
+// AVX2 versions.  Each Game chooses the best set the processor can
+// run when it is built, before any search starts, and calls it 
+// through Game::KernelSet() from then on.  kernel-benchmark times each
+// set, and unittests checks that they all agree.
+//
+// The SSE4.2 and AVX2 versions load whole registers from a PileVec, 
+// reading past its size() into its spare capacity.  That is intended:
+// the bytes read stay within the PileVec's array, and the lanes past
+// the cards asked about are masked off.  Kernels.cpp asserts that the
+// capacity allows it.
+
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include "Game.hpp"
+
+namespace KSolveNames {
+
+using TableauCodeArray = std::array<uint32_t,TableauSize>;
+
+struct Kernels
+{
+    const char* _name;
+    // Copy codes to sorted in ascending order
+    void (*_sortTableauCodes)(const TableauCodeArray& codes, TableauCodeArray& sorted) noexcept;
+    // Return the IsMajor() bits of the n cards of pile starting at
+    // first, the last card's in the lowest bit.  first <= 8, n <= 16.
+    unsigned (*_majorSuitBits)(const PileVec& pile, unsigned first, unsigned n) noexcept;
+    // Return the number of the first n cards of pile that come after
+    // a lower card of the same suit.
+    unsigned (*_misorderCount)(const PileVec& pile, unsigned n) noexcept;
+};
+
+// The sets of kernels this processor can run, scalar first
+static_vector<const Kernels*,3> AvailableKernels() noexcept;
+// The last of AvailableKernels(), which Game uses
+const Kernels& BestKernels() noexcept;
+}   // namespace KSolveNames
+
+#endif      // KERNELS_HPP
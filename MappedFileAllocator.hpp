@@ -0,0 +1,121 @@
+// MappedFileAllocator.hpp defines an allocator that can put a big
+// array in a memory-mapped temporary file instead of on the heap.
+//
+// It is meant for a std::vector that is sized once with reserve() and
+// never reallocated, like the move tree.  The file is created sparse and
+// unlinked at once, so it takes disk space only for pages that have been
+// written and disappears when the mapping is removed.  Since the mapping
+// is backed by the file rather than by swap space, the operating system
+// can page out regions that have not been used lately, and the array can
+// be larger than the RAM available.
+//
+// With an empty directory name, or on systems without mmap(), or if the
+// file cannot be created, it allocates from the heap.  IsMapped() tells
+// which happened.
+
+#ifndef MAPPEDFILEALLOCATOR_HPP
+#define MAPPEDFILEALLOCATOR_HPP
+
+#include <string>
+#include <new>
+#include <type_traits>
+#if defined(__unix__) || defined(__APPLE__)
+#define KSOLVE_HAS_MMAP 1
+#include <sys/mman.h>
+#include <unistd.h>         // ftruncate, close, unlink
+#include <cstdlib>          // mkstemp
+#endif
+
+namespace KSolveNames {
+
+template <class T>
+class MappedFileAllocator
+{
+    std::string _directory;
+    T* _mapped{nullptr};
+    size_t _mappedSize{0};
+
+    template <class U> friend class MappedFileAllocator;
+
+#ifdef KSOLVE_HAS_MMAP
+    T* MapFile(size_t nBytes)
+    {
+        std::string path = _directory + "/KSolveMoveTreeXXXXXX";
+        int fd = mkstemp(path.data());
+        if (fd < 0) return nullptr;
+        unlink(path.c_str());
+        void* p = MAP_FAILED;
+        if (ftruncate(fd, nBytes) == 0) {
+            p = mmap(nullptr, nBytes, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_NORESERVE, fd, 0);
+        }
+        close(fd);          // the mapping keeps the file open
+        if (p == MAP_FAILED) return nullptr;
+        // Parent walks jump around the file, so read-ahead would
+        // mostly fetch pages nobody wants.
+        madvise(p, nBytes, MADV_RANDOM);
+        return static_cast<T*>(p);
+    }
+#else
+    T* MapFile(size_t) {return nullptr;}
+#endif
+
+public:
+    using value_type = T;
+    // An allocator's mapping goes with it when its container is moved 
+    // or swapped.  A copy of a container gets an allocator of its own,
+    // which maps a file of its own.
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    MappedFileAllocator() noexcept = default;
+    // Map allocations into temporary files in directory, or allocate
+    // them from the heap if directory is empty.
+    explicit MappedFileAllocator(const std::string& directory) noexcept
+        : _directory(directory)
+        {}
+    template <class U>
+    MappedFileAllocator(const MappedFileAllocator<U>& other) noexcept
+        : _directory(other._directory)
+        {}
+
+    T* allocate(size_t n)
+    {
+        if (_directory.size() && !_mapped) {
+            _mapped = MapFile(n*sizeof(T));
+            if (_mapped) {
+                _mappedSize = n*sizeof(T);
+                return _mapped;
+            }
+            _directory.clear();
+        }
+        return static_cast<T*>(::operator new(n*sizeof(T)));
+    }
+    void deallocate(T* p, size_t) noexcept
+    {
+#ifdef KSOLVE_HAS_MMAP
+        if (p == _mapped) {
+            munmap(p, _mappedSize);
+            _mapped = nullptr;
+            return;
+        }
+#endif
+        ::operator delete(p);
+    }
+    MappedFileAllocator select_on_container_copy_construction() const noexcept
+    {
+        return MappedFileAllocator(_directory);
+    }
+    // True if the array is in a memory-mapped file
+    bool IsMapped() const noexcept {return _mapped != nullptr;}
+    // Either can free what the other allocated if both hold the same
+    // mapping or neither holds one, since heap memory is freed alike.
+    bool operator==(const MappedFileAllocator& other) const noexcept
+    {
+        return _mapped == other._mapped;
+    }
+};
+}   // namespace KSolveNames
+
+#endif      // MAPPEDFILEALLOCATOR_HPP
@@ -1,5 +1,6 @@
 #include "MoveStorage.hpp"
 #include <iostream>
+#include <span>
 
 namespace KSolveNames {
 
@@ -30,41 +31,50 @@ void MoveStorage::PushBranch(MoveSpec mv, unsigned nMoves) noexcept
 {
     _branches.emplace_back(mv,nMoves);
 }
-void MoveStorage::ShareMoves() noexcept
+void MoveStorage::ShareMoves(unsigned minMoves) noexcept
 {
     // If _branches is empty, a dead end has been reached.  There
     // is no need to store any stem moves that led to it.
     if (_branches.size()) {
         UpdateMoveTreeBuffer();
+        auto keeper = ranges::find_if(_branches, 
+            [minMoves](const MovePair& br) {return br._nMoves == minMoves;});
+        if (keeper != _branches.end()) {
+            _keptBranch.emplace(keeper->_mv, _stemIndex, 
+                                keeper->_nMoves-_shared._initialMinMoves);
+            _branches.erase(keeper);
+        }
         UpdateFringeBuffer();
         _branches.clear();
     }
 }
 void MoveStorage::UpdateMoveTreeBuffer() noexcept
 {
-
     // Skip the case where the initial layout has no stem moves.
     if (_currentSequence.size() > _startSize) {
-        _treeBuffer.emplace_back(_currentSequence[_startSize], _leaf._prevBranchIndex, false);
-        for (auto m: _currentSequence | views::drop(_startSize+1))
-        {
-            _treeBuffer.emplace_back(m, _treeBuffer.size()-1, true);
-        }
+        const auto stem = _currentSequence | views::drop(_startSize);
+        _stemIndex = _leafParentIsBuffered
+                   ? _treeBuffer.PushChild(_leaf._prevBranchIndex, stem)
+                   : _treeBuffer.Push(_leaf._prevBranchIndex, stem);
+    } else {
+        assert(_leaf._prevBranchIndex == -1U);
+        _stemIndex = -1U;
     }
-
 } 
 void MoveStorage::UpdateFringeBuffer() noexcept
 {
-    unsigned backIndex = (_treeBuffer.size())
-                         ? _treeBuffer.size()-1
-                         : _leaf._prevBranchIndex;
     for (const auto &br: _branches) {
-        _fringeBuffer.emplace_back(br._mv, backIndex, br._nMoves-_shared._initialMinMoves);
+        _fringeBuffer.emplace_back(br._mv, _stemIndex, br._nMoves-_shared._initialMinMoves);
     }
 }
 // Flush the buffers to the shared data structures
 void MoveStorage::Flush() noexcept
 {
+    if (_keptBranch) {
+        _fringeBuffer.emplace_back(_keptBranch->_move, 
+            _keptBranch->_location, _keptBranch->_offset);
+        _keptBranch.reset();
+    }
     unsigned treeSize = FlushTreeBuffer();
     FlushFringeBuffer(treeSize);
 }
@@ -75,12 +85,7 @@ uint32_t MoveStorage::FlushTreeBuffer() noexcept
     uint32_t treeSize;
     {
         Guard Alysa(_shared._moveTreeMutex);
-        treeSize = moveTree.size();
-        for (auto mv: _treeBuffer) {
-            uint32_t loc = mv._location;
-            if (mv._isRelative) loc += treeSize;
-            moveTree.emplace_back(mv._move, loc);
-        }
+        treeSize = moveTree.Append(_treeBuffer);
     }
     _treeBuffer.clear();
     return treeSize;
@@ -99,7 +104,10 @@ void MoveStorage::FlushFringeBuffer(uint32_t treeSize)  noexcept
         // minimum move counts.
         do {
             auto &elem{_fringeBuffer[i]};
-            branches.emplace_back(elem._move, elem._location+treeSize);
+            const MoveX location = (elem._location == -1U)
+                                 ? -1U
+                                 : elem._location+treeSize;
+            branches.emplace_back(elem._move, location);
             ++i;
         } while (i < _fringeBuffer.size() && 
                 _fringeBuffer[i]._offset == offset);
@@ -110,11 +118,25 @@ void MoveStorage::FlushFringeBuffer(uint32_t treeSize)  noexcept
 }
 // If the work queue (aka fringe) is empty, return 0.
 // Otherwise, pop a move sequence with the lowest available
-// minimum move count, redeal the deck, make all the moves in
-// that sequence to return the game to the state it was in when
+// minimum move count, return the game to the state it was in when
 // that sequence was saved, and return its minimum move count.
 unsigned MoveStorage::PopNextBranch(Game& game ) noexcept
 {
+    if (_keptBranch) {
+        const FringeElement kept = *_keptBranch;
+        _keptBranch.reset();
+        if (!BuffersNearlyFull() && kept._offset <= _fringeBuffer.MinOffset()) {
+            // Expand the kept branch from the current game state.
+            _leaf = Branch(kept._move, kept._location);
+            _leafParentIsBuffered = kept._location != -1U;
+            _startSize = _currentSequence.size();
+            _currentSequence.push_back(kept._move);
+            game.MakeMove(kept._move);
+            return kept._offset + _shared._initialMinMoves;
+        }
+        // Share it with the others instead.
+        _fringeBuffer.emplace_back(kept._move, kept._location, kept._offset);
+    }
     if (BuffersNearlyFull()) Flush();  
     
     auto & fringe {_shared._fringe};
@@ -137,34 +159,130 @@ unsigned MoveStorage::PopNextBranch(Game& game ) noexcept
     if (nextLeaf) {
         unsigned offset = nextLeaf->first;
         _leaf = nextLeaf->second;
+        _leafParentIsBuffered = false;
         // Restore game to the state it had when this move
         // sequence was enqueued.
-        game.Deal();
-        LoadMoveSequence();
-        MakeSequenceMoves(game);
+        LoadMoveSequence(game);
         return offset +_shared._initialMinMoves;
     } else {
         return 0;     // fringe is empty
     }
 }
-void MoveStorage::LoadMoveSequence() noexcept
+// Consecutive leaves popped by one thread usually share most of their
+// ancestors.  Rather than redeal and make every move in the new sequence,
+// this follows the links from the new leaf only back to the deepest stem
+// it shares with the current sequence, unmakes the current sequence's
+// moves after that stem, and makes the new moves.  If one of the new
+// stems has a snapshot in the restore cache and restoring it saves 
+// enough moves, it restores that and makes only the moves after it.
+void MoveStorage::LoadMoveSequence(Game& game) noexcept
 {
-    // Follow the links to recover all the moves in a sequence in reverse order.
-    _currentSequence.clear();
+    const auto& moveTree{_shared._moveTree};
+
+    // Find the new sequence's stems that are not in the current one,
+    // their moves, and how many there are.
+    static_vector<MoveX,MaxSequenceLength> newStems;
+    static_vector<std::pair<const MoveSpec*,const MoveSpec*>,MaxSequenceLength> newMoveRanges;
+    unsigned commonDepth = 0;
     for    (MoveX ix = _leaf._prevBranchIndex; 
-            ix != -1U; 
-            ix = _shared._moveTree[ix]._prevBranchIndex){
-        const MoveSpec &mv = _shared._moveTree[ix]._move;
-        _currentSequence.push_front(mv);
+            ix != -1U && !(commonDepth = PathDepth(ix)); 
+            ix = moveTree.Parent(ix)) {
+        newStems.push_back(ix);
+        newMoveRanges.push_back(moveTree.Moves(ix));
     }
+    unsigned commonSize = commonDepth ? _pathEnds[commonDepth-1] : 0;
+    const unsigned unmakeCost = _currentSequence.size() - commonSize;
+
+    // If loading the new sequence would take enough moves, look for the
+    // deepest new stem in the restore cache.  Restoring its snapshot
+    // saves backing up and making the moves down to it.
+    std::optional<GameSnapshot> snapshot;
+    unsigned cachedIndex = 0;       // index in newStems of the cached stem
+#ifdef KSOLVE_RESTORE_CACHE
+    const unsigned backUpCost = std::min(unmakeCost, commonSize + RedealCost);
+    unsigned newMoves = 0;
+    for (const auto& [first, last]: newMoveRanges) newMoves += last - first;
+    unsigned skipped = newMoves;    // moves in the cached stem and those above it
+    if (RestoreCacheMinMoves <= backUpCost + newMoves) {
+        for (; cachedIndex < newStems.size() && RestoreCost < backUpCost + skipped; ++cachedIndex) {
+            if ((snapshot = _restoreCache.get(newStems[cachedIndex]))) break;
+            const auto [first, last] = newMoveRanges[cachedIndex];
+            skipped -= last - first;
+        }
+        _restoreCacheHits += snapshot.has_value();
+        _restoreCacheMisses += !snapshot;
+    }
+#endif
+    const bool restore = snapshot.has_value();
+
+    // Back up to the end of the common stems, either by unmaking
+    // moves or, if that would take more moves, by redealing and 
+    // making the common moves again.
+    if (restore) {
+        // The game is restored below.
+        while (_currentSequence.size() > commonSize) {
+            _currentSequence.pop_back();
+        }
+    } else if (unmakeCost <= commonSize + RedealCost) {
+        while (_currentSequence.size() > commonSize) {
+            game.UnMakeMove(_currentSequence.back());
+            _currentSequence.pop_back();
+        }
+    } else {
+        game.Deal();
+        while (_currentSequence.size() > commonSize) {
+            _currentSequence.pop_back();
+        }
+        for (auto mv: _currentSequence) {
+            game.MakeMove(mv);
+        }
+    }
+    _pathStems.resize(commonDepth);
+    _pathEnds.resize(commonDepth);
+
+    // Copy the moves in the new stems.  Make those after the cached
+    // stem if the game was restored, or all of them if not.
+    for (unsigned i = newStems.size(); i-- > 0; ) {
+        const auto [first, last] = newMoveRanges[i];
+        _currentSequence.append(first, last, MoveCount(std::span(first, last)));
+        _currentSequence.back().EndsStem(false);
+        if (restore && i == cachedIndex) {
+            game.Restore(*snapshot);
+        } else if (!restore || i < cachedIndex) {
+            for (auto mv: _currentSequence | views::drop(_pathEnds.size() ? _pathEnds.back() : 0)) {
+                game.MakeMove(mv);
+            }
+        }
+        _pathStems.push_back(newStems[i]);
+        _pathEnds.push_back(_currentSequence.size());
+    }
+    // Cache the state the leaf grew from if it took enough moves to
+    // reach.  Its siblings may be popped after this thread has moved 
+    // elsewhere in the tree.
+#ifdef KSOLVE_RESTORE_CACHE
+    const unsigned movesMade = restore ? newMoves-skipped : backUpCost+newMoves;
+    if (newStems.size() && RestoreCacheMinMoves <= movesMade) {
+        _restoreCache.insert(newStems[0], game.Save());
+    }
+#endif
     _startSize = _currentSequence.size();
     _currentSequence.push_back(_leaf._move);
+    game.MakeMove(_leaf._move);
 }
-void MoveStorage::MakeSequenceMoves(Game&game) const noexcept
+#ifdef KSOLVE_RESTORE_CACHE
+void MoveStorage::ShareRestoreCacheCounts() noexcept
 {
-    for (auto & move: _currentSequence){
-        game.MakeMove(move);
-    }
+    _shared._restoreCacheHits += _restoreCacheHits;
+    _shared._restoreCacheMisses += _restoreCacheMisses;
+    _restoreCacheHits = _restoreCacheMisses = 0;
+}
+#endif
+unsigned MoveStorage::PathDepth(MoveX stem) const noexcept
+{
+    const auto p = ranges::lower_bound(_pathStems, stem);
+    return (p != _pathStems.end() && *p == stem) 
+        ? p - _pathStems.begin() + 1
+        : 0;
 }
 }   // namespace KSolveNames 
 
@@ -1,11 +1,14 @@
 #include "ShareableIndexedPriorityQueue.hpp"
 #include "Game.hpp"
+#include "MoveTree.hpp"
 #include "frystl/static_deque.hpp"
+#ifdef KSOLVE_RESTORE_CACHE
+#include "gtl/lru_cache.hpp"
+#endif
+#include <atomic>
 
 namespace KSolveNames {
 
-using MoveX = uint32_t;
-
 struct Branch
 {
     MoveSpec _move;
@@ -22,19 +25,28 @@ class SharedMoveStorage
 {
 private:
     const size_t _moveTreeSizeLimit;
-    std::vector<Branch> _moveTree;
+    MoveTree _moveTree;
     Mutex _moveTreeMutex;
     // The leaves waiting to grow new branches.  
     // Also, the task queue.
     ShareableIndexedPriorityQueue<unsigned, Branch, 512> _fringe;
     const unsigned _initialMinMoves;
+#ifdef KSOLVE_RESTORE_CACHE
+    // Totals of the MoveStorage restore cache counts
+    std::atomic_uint _restoreCacheHits{0};
+    std::atomic_uint _restoreCacheMisses{0};
+#endif
     friend class MoveStorage;
 public:
-    SharedMoveStorage(size_t moveTreeSizeLimit, unsigned minMoves) noexcept
+    // If moveTreeDirectory is not empty, the move tree is kept in
+    // a temporary file in that directory.
+    SharedMoveStorage(size_t moveTreeSizeLimit, unsigned minMoves,
+                      const std::string& moveTreeDirectory = "") noexcept
         : _moveTreeSizeLimit(moveTreeSizeLimit)
+        , _moveTree(moveTreeDirectory)
         , _initialMinMoves(minMoves)
     {
-        _moveTree.reserve(moveTreeSizeLimit+1000);
+        _moveTree.Reserve(moveTreeSizeLimit+1000);
     }
     unsigned InitialMinMoves() const noexcept {
         return _initialMinMoves;
@@ -43,11 +55,24 @@ public:
         return _fringe.Size();
     }
     unsigned MoveTreeSize() const noexcept{
-        return _moveTree.size();
+        return _moveTree.MoveSpecCount();
     }
     bool OverLimit() const noexcept{
-        return _moveTree.size() > _moveTreeSizeLimit;
+        return _moveTree.MoveSpecCount() > _moveTreeSizeLimit;
+    }
+    // True if the move tree is in a memory-mapped file.  It is in 
+    // main memory if no directory was given or no file could be mapped.
+    bool IsMapped() const noexcept{
+        return _moveTree.IsMapped();
+    }
+#ifdef KSOLVE_RESTORE_CACHE
+    unsigned RestoreCacheHits() const noexcept{
+        return _restoreCacheHits;
+    }
+    unsigned RestoreCacheMisses() const noexcept{
+        return _restoreCacheMisses;
     }
+#endif
 };
 
 class MoveStorage
@@ -64,18 +89,30 @@ public:
     // i.e. its the minimum move count.
     void PushBranch(MoveSpec move, unsigned moveCount) noexcept;
     // Push all the moves (stem and branch) from this trip
-    // through the main loop into shared storage.
-    void ShareMoves() noexcept;
+    // through the main loop into shared storage, except that
+    // one branch whose minimum move count equals minMoves, the
+    // minimum move count of the leaf this trip started from,
+    // may be kept for this thread to expand next.  Since no leaf
+    // in the fringe can have a smaller minimum move count, expanding
+    // it next keeps A* order, and the game need not be restored.
+    void ShareMoves(unsigned minMoves) noexcept;
     // If the task queue is empty return 0.  Otherwise,
     // pop the next branch from the task queue, restore the 
     // game to the state it was in when that branch was pushed,
     // and return the heuristic value of that state.
+    // The game must be in the state reached by making the moves
+    // in MoveSequence() from the deal.
     unsigned PopNextBranch(Game& game) noexcept;
-    // Flush the buffer to the shared data structures
+    // Flush the buffers, including any kept branch, to the shared data structures
     void Flush() noexcept;
+#ifdef KSOLVE_RESTORE_CACHE
+    // Add this thread's restore cache hit and miss counts to the shared totals
+    void ShareRestoreCacheCounts() noexcept;
+#endif
     // Return a const reference to the current move sequence in its
     // native type.
-    using MoveSequenceType = MoveCounter<static_deque<MoveSpec,500>>;
+    static constexpr unsigned MaxSequenceLength{500};
+    using MoveSequenceType = LastTouchSequence<MaxSequenceLength>;
     const MoveSequenceType& MoveSequence() const noexcept {return _currentSequence;}
 private:
     SharedMoveStorage &_shared;
@@ -83,6 +120,22 @@ private:
     MoveSequenceType _currentSequence;
     Branch _leaf{};	        // current sequence's starting leaf
     long _startSize{0};    // number of MoveSpecs gotten from the move tree.
+    // The stems in the current sequence gotten from the move tree, 
+    // root first, and the size of the current sequence at the end 
+    // of each.  Since stems are always added to the tree after their
+    // parents, the indexes are in ascending order.
+    static_vector<MoveX,MaxSequenceLength> _pathStems;
+    static_vector<unsigned short,MaxSequenceLength> _pathEnds;
+
+    struct FringeElement {
+        MoveSpec _move;
+        uint32_t _location;         // offset from end of tree at start of Flush(), or -1U
+        uint32_t _offset;
+        bool operator<(const FringeElement & other) const noexcept
+        {
+            return _offset < other._offset;
+        }
+    };
     struct MovePair
     {
         MoveSpec _mv;
@@ -93,34 +146,49 @@ private:
         {}
     };
     static_vector<MovePair,32> _branches{};
+    // The branch ShareMoves() kept for this thread, if any.
+    std::optional<FringeElement> _keptBranch;
+    // True if _leaf._prevBranchIndex is an index into _treeBuffer
+    bool _leafParentIsBuffered{false};
     void  UpdateMoveTreeBuffer() noexcept; 
     void UpdateFringeBuffer() noexcept;
     uint32_t FlushTreeBuffer() noexcept;
     void FlushFringeBuffer(uint32_t treeSize) noexcept;
 
-    // Copy the moves in the current sequence from the move tree.
-    void LoadMoveSequence() noexcept; 
-    // Make all the moves in the current sequence
-    void MakeSequenceMoves(Game&game) const noexcept;
+    // Game::Deal() costs about as much as making this many moves
+    static constexpr unsigned RedealCost{4};
 
-    // Buffering
-    struct MoveTreeElement {
-        MoveSpec _move;
-        uint32_t _location;      // subscript in _moveTree or offset from end of tree
-        bool _isRelative;        // _location is relative to _moveTree size -1
-    };
-    struct FringeElement {
-        MoveSpec _move;
-        uint32_t _location;         // offset from end of tree at start of Flush()
-        uint32_t _offset;
-        bool operator<(const FringeElement & other) const noexcept
-        {
-            return _offset < other._offset;
-        }
-    };
+    // The restore cache holds snapshots of the game at the ends of stems
+    // in the move tree this thread has loaded, most recently used first.  
+    // When a new leaf's path from the root leaves the current sequence,
+    // LoadMoveSequence() can start from the deepest cached stem on it
+    // rather than from the last stem it shares with the current sequence.
+    // It is compiled only if KSOLVE_RESTORE_CACHE is defined.  Since
+    // LoadMoveSequence() seldom needs to make many moves, it has not
+    // paid for itself in tests with one thread.
+#ifdef KSOLVE_RESTORE_CACHE
+    // Game::Restore() costs about as much as making this many moves,
+    // counting the lookups in the restore cache
+    static constexpr unsigned RestoreCost{16};
+    static constexpr unsigned RestoreCacheSize{4096};
+    // Loads that take fewer moves than this neither use the cache
+    // nor add to it.
+    static constexpr unsigned RestoreCacheMinMoves{40};
+    gtl::lru_cache<MoveX,GameSnapshot> _restoreCache{RestoreCacheSize};
+    unsigned _restoreCacheHits{0};      // loads that found a snapshot
+    unsigned _restoreCacheMisses{0};    // loads that looked and found none
+#endif
+    // Replace the current sequence with the one leading to _leaf
+    // and make the same changes to the game.
+    void LoadMoveSequence(Game& game) noexcept; 
+    // Return the number of stems in _pathStems up to and including 
+    // stem, or 0 if stem is not there.
+    unsigned PathDepth(MoveX stem) const noexcept;
 
+    // Buffering
     static const unsigned _maxBufferSize{256};
-    std::vector<MoveTreeElement> _treeBuffer{};
+    MoveTree::Buffer _treeBuffer{};
+    MoveX _stemIndex{-1U};         // index in _treeBuffer of the stem just buffered
     class FringeBufferT : public std::vector<FringeElement> 
     {
     private:    
@@ -144,7 +212,7 @@ private:
     }   _fringeBuffer{};
 
     bool BuffersNearlyFull() {
-        return _maxBufferSize < _treeBuffer.size()+52 
+        return _maxBufferSize < _treeBuffer.MoveSpecCount()+52 
             || _maxBufferSize < _fringeBuffer.size()+20;
     }
 };
@@ -0,0 +1,295 @@
+// MoveTree.hpp declares the move tree, the shared structure that
+// records every move sequence that has led to a branching node.
+//
+// The tree is made of stems.  A stem is the run of moves made by one
+// trip through the solver's main loop: the leaf taken from the fringe
+// followed by the no-choice moves made after it.  Since every node 
+// within a stem has the previous node as its parent, only the first
+// needs a link.  The last MoveSpec in a stem is marked by EndsStem().
+//
+// The fringe refers to stems only by their indexes, and a stem's 
+// children always follow it from its last move.
+//
+// Stems are added in blocks from a Buffer.  A stem's parent may be
+// in the tree or earlier in the same Buffer.
+//
+// Two layouts are defined here.  Both have the same interface.
+//
+// PackedMoveTree stores each stem as a four-byte header holding the 
+// index of its parent stem followed immediately by its MoveSpecs, 
+// packed four bytes each.  A stem that holds only the leaf move thus 
+// takes the same eight bytes as a {move, link} pair, and each added 
+// stem move takes four.  A stem's index is the subscript of its header.
+//
+// SplitMoveTree stores the links in one array and the MoveSpecs in
+// another, so a walk from a leaf to the root touches only the links.
+// It then fetches the moves in a second pass that can be prefetched.
+// A stem's index is its row in the link array.
+//
+// Compile with KSOLVE_SPLIT_MOVE_TREE defined to make MoveTree the
+// split layout.
+//
+// Either layout can keep its MoveSpecs in a memory-mapped temporary
+// file (see MappedFileAllocator.hpp) rather than on the heap.  Only
+// PackedMoveTree keeps its links there too.
+#ifndef MOVETREE_HPP
+#define MOVETREE_HPP
+
+#include "Game.hpp"
+#include "MappedFileAllocator.hpp"
+#include "gtl/soa.hpp"
+#include <bit>              // bit_cast
+#include <span>
+#include <vector>
+#ifdef _MSC_VER
+#include <xmmintrin.h>      // _mm_prefetch
+#endif
+
+namespace KSolveNames {
+
+using MoveX = uint32_t;
+
+inline void PrefetchForRead(const void* p) noexcept
+{
+#if defined(_MSC_VER)
+    _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+    __builtin_prefetch(p);
+#endif
+}
+
+// Return pointers to the first MoveSpec in the stem starting 
+// at *first* and one past its last.
+inline std::pair<const MoveSpec*,const MoveSpec*> 
+StemMoves(const MoveSpec* first) noexcept
+{
+    const MoveSpec* last = first;
+    while (!last->EndsStem()) ++last;
+    return {first, last+1};
+}
+
+class PackedMoveTree
+{
+    // A stem's header holds its parent's index in a MoveSpec's slot.
+    static_assert(sizeof(MoveX) == sizeof(MoveSpec));
+    static MoveSpec LinkSlot(MoveX parent) noexcept
+    {
+        return std::bit_cast<MoveSpec>(parent);
+    }
+public:
+    // Stems waiting to be appended to the tree, in the tree's layout.
+    // Parent indexes must already be in the tree.
+    class Buffer
+    {
+        std::vector<MoveSpec> _slots;
+        size_t _nMoveSpecs{0};
+        std::vector<MoveX> _localLinks;     // links to stems in this buffer
+        friend class PackedMoveTree;
+    public:
+        // Append a stem.  Returns its index relative to the start
+        // of this buffer.
+        template <class MoveRange>
+        MoveX Push(MoveX parent, const MoveRange& moves) noexcept
+        {
+            assert(moves.size());
+            const MoveX result = _slots.size();
+            _slots.push_back(LinkSlot(parent));
+            _slots.insert(_slots.end(), moves.begin(), moves.end());
+            _slots.back().EndsStem(true);
+            _nMoveSpecs += moves.size();
+            return result;
+        }
+        // Append a stem whose parent is in this buffer.  
+        // *parent* is an index returned by Push() or PushChild().
+        template <class MoveRange>
+        MoveX PushChild(MoveX parent, const MoveRange& moves) noexcept
+        {
+            const MoveX result = Push(parent, moves);
+            _localLinks.push_back(result);
+            return result;
+        }
+        size_t MoveSpecCount() const noexcept   {return _nMoveSpecs;}
+        void reserve(size_t n)                  {_slots.reserve(n);}
+        void clear() noexcept
+        {
+            _slots.clear();
+            _nMoveSpecs = 0;
+            _localLinks.clear();
+        }
+    };
+private:
+    std::vector<MoveSpec, MappedFileAllocator<MoveSpec>> _slots;
+    size_t _moveSpecCount{0};
+
+public:
+    // If fileDirectory is not empty, keep the tree in a 
+    // temporary file there.
+    explicit PackedMoveTree(const std::string& fileDirectory = "")
+        : _slots(MappedFileAllocator<MoveSpec>(fileDirectory))
+        {}
+    // Reserve room for nMoveSpecs MoveSpecs.  The caller must
+    // never let the tree outgrow that, since other threads read it
+    // without locking.  A stem never takes more than two slots per 
+    // MoveSpec it holds.
+    void Reserve(size_t nMoveSpecs)
+    {
+        _slots.reserve(2*nMoveSpecs);
+    }
+    size_t MoveSpecCount() const noexcept   {return _moveSpecCount;}
+    bool IsMapped() const noexcept          {return _slots.get_allocator().IsMapped();}
+    size_t SizeInBytes() const noexcept     {return _slots.size()*sizeof(MoveSpec);}
+
+    // Append the stems in a buffer.  Returns the amount to add to 
+    // the indexes returned by Buffer::Push() to get their indexes 
+    // in the tree.
+    MoveX Append(const Buffer& buffer) noexcept
+    {
+        MoveX result = _slots.size();
+        _slots.insert(_slots.end(), buffer._slots.begin(), buffer._slots.end());
+        for (MoveX stem: buffer._localLinks) {
+            _slots[result+stem] = LinkSlot(Parent(result+stem) + result);
+        }
+        _moveSpecCount += buffer._nMoveSpecs;
+        return result;
+    }
+
+    MoveX Parent(MoveX stem) const noexcept
+    {
+        return std::bit_cast<MoveX>(_slots[stem]);
+    }
+    std::pair<const MoveSpec*,const MoveSpec*> Moves(MoveX stem) const noexcept
+    {
+        return StemMoves(&_slots[stem+1]);
+    }
+    // The moves follow the link, so Parent() has already fetched them.
+    void Prefetch(MoveX) const noexcept {}
+};
+
+class SplitMoveTree
+{
+    using StemTable = gtl::soa<
+            MoveX,                  // index of parent stem
+            MoveX                   // subscript of first move in _moves
+        >;
+    enum {ParentCol, FirstMoveCol};
+public:
+    class Buffer
+    {
+        StemTable _stems;
+        std::vector<MoveSpec> _moves;
+        std::vector<bool> _isLocalLink;
+        friend class SplitMoveTree;
+    public:
+        template <class MoveRange>
+        MoveX Push(MoveX parent, const MoveRange& moves) noexcept
+        {
+            assert(moves.size());
+            const MoveX result = _stems.size();
+            _stems.insert(parent, MoveX(_moves.size()));
+            _moves.insert(_moves.end(), moves.begin(), moves.end());
+            _moves.back().EndsStem(true);
+            _isLocalLink.push_back(false);
+            return result;
+        }
+        template <class MoveRange>
+        MoveX PushChild(MoveX parent, const MoveRange& moves) noexcept
+        {
+            const MoveX result = Push(parent, moves);
+            _isLocalLink.back() = true;
+            return result;
+        }
+        size_t MoveSpecCount() const noexcept   {return _moves.size();}
+        void reserve(size_t n)
+        {
+            _stems.reserve(n);
+            _moves.reserve(n);
+            _isLocalLink.reserve(n);
+        }
+        void clear() noexcept
+        {
+            _stems.clear();
+            _moves.clear();
+            _isLocalLink.clear();
+        }
+    };
+private:
+    StemTable _stems;
+    std::vector<MoveSpec, MappedFileAllocator<MoveSpec>> _moves;
+
+public:
+    // If fileDirectory is not empty, keep the MoveSpecs in a 
+    // temporary file there.
+    explicit SplitMoveTree(const std::string& fileDirectory = "")
+        : _moves(MappedFileAllocator<MoveSpec>(fileDirectory))
+        {}
+    void Reserve(size_t nMoveSpecs)
+    {
+        _stems.reserve(nMoveSpecs);
+        _moves.reserve(nMoveSpecs);
+    }
+    size_t MoveSpecCount() const noexcept   {return _moves.size();}
+    bool IsMapped() const noexcept          {return _moves.get_allocator().IsMapped();}
+    size_t SizeInBytes() const noexcept
+    {
+        return _stems.size()*2*sizeof(MoveX) + _moves.size()*sizeof(MoveSpec);
+    }
+
+    MoveX Append(const Buffer& buffer) noexcept
+    {
+        const MoveX result = _stems.size();
+        const MoveX movesBase = _moves.size();
+        const auto& parents = buffer._stems.get_column<ParentCol>();
+        const auto& firsts = buffer._stems.get_column<FirstMoveCol>();
+        for (unsigned i = 0; i < parents.size(); ++i) {
+            const MoveX parent = parents[i] + (buffer._isLocalLink[i] ? result : 0);
+            _stems.insert(parent, firsts[i]+movesBase);
+        }
+        _moves.insert(_moves.end(), buffer._moves.begin(), buffer._moves.end());
+        return result;
+    }
+
+    // Also starts fetching what Prefetch() will need.
+    MoveX Parent(MoveX stem) const noexcept
+    {
+        PrefetchForRead(&_stems.get_column<FirstMoveCol>()[stem]);
+        return _stems.get_column<ParentCol>()[stem];
+    }
+    std::pair<const MoveSpec*,const MoveSpec*> Moves(MoveX stem) const noexcept
+    {
+        return StemMoves(&_moves[_stems.get_column<FirstMoveCol>()[stem]]);
+    }
+    void Prefetch(MoveX stem) const noexcept
+    {
+        PrefetchForRead(&_moves[_stems.get_column<FirstMoveCol>()[stem]]);
+    }
+};
+
+#ifdef KSOLVE_SPLIT_MOVE_TREE
+using MoveTree = SplitMoveTree;
+#else
+using MoveTree = PackedMoveTree;
+#endif
+
+// Copy into *sequence* all the moves in the stems from the root
+// through *stem*.  *sequence* must be a MoveCounter.  Follows the links 
+// to find the stems, then copies their moves root first.
+template <class Tree, class Sequence>
+void LoadStems(const Tree& tree, MoveX stem, Sequence& sequence) noexcept
+{
+    static_vector<MoveX, 512> stems;
+    for (MoveX ix = stem; ix != -1U; ix = tree.Parent(ix)){
+        stems.push_back(ix);
+    }
+    for (MoveX ix: stems) {
+        tree.Prefetch(ix);
+    }
+    sequence.clear();
+    for (MoveX ix: views::reverse(stems)) {
+        const auto [first, last] = tree.Moves(ix);
+        sequence.append(first, last, MoveCount(std::span(first, last)));
+        sequence.back().EndsStem(false);
+    }
+}
+}   // namespace KSolveNames
+
+#endif      // MOVETREE_HPP
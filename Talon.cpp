@@ -0,0 +1,103 @@
+// Talon.cpp implements the talon simulation declared in Talon.hpp.
+
+#include "Talon.hpp"
+
+namespace KSolveNames {
+
+// Class to simulate draws and recycles of the talon
+class TalonSim{
+    unsigned _wSize;
+    unsigned _sSize;
+public:
+    TalonSim(unsigned wasteSize, unsigned stockSize)
+        : _wSize(wasteSize)
+        , _sSize(stockSize)
+        {}
+    unsigned WasteSize() const noexcept
+    {
+        return _wSize;
+    }
+    unsigned StockSize() const noexcept
+    {
+        return _sSize;
+    }
+    void Cycle() noexcept
+    {
+        _sSize = _wSize;
+        _wSize = 0;
+    }
+    void Draw(unsigned n) noexcept
+    {
+        n = std::min<unsigned>(n, _sSize);
+        _wSize += n;
+        _sSize -= n;
+    }
+};
+
+TalonSteps SimulateTalon(unsigned wasteSize, unsigned stockSize,
+                         unsigned drawSetting, unsigned maxRecycles) noexcept
+{
+    TalonSteps result;
+    if (wasteSize + stockSize == 0) return result;
+
+    TalonSim talon(wasteSize, stockSize);
+    unsigned nMoves = 0;
+    unsigned nRecycles = 0;
+
+    do {
+        if (talon.WasteSize()) {
+            result.push_back({
+                static_cast<unsigned char>(talon.WasteSize()), 
+                static_cast<unsigned char>(nMoves), 
+                nRecycles>0});
+        }	
+        if (talon.StockSize()) {
+            // Draw from the stock pile
+            nMoves++;
+            talon.Draw(drawSetting);
+        } else {
+            // Recycle the waste pile
+            nRecycles++;
+            talon.Cycle();
+        }
+    } while (talon.WasteSize() != wasteSize && nRecycles <= maxRecycles);
+    return result;
+}
+
+// The steps for every talon size, filled in as they are needed.
+// Since a solver thread uses one draw setting, the cache is 
+// emptied only when that changes.
+class TalonStepCache
+{
+    static constexpr unsigned MaxSize{24};
+    struct Entry {
+        TalonSteps _steps;
+        bool _filled{false};
+    };
+    std::array<Entry,(MaxSize+1)*(MaxSize+1)*2> _entries;
+    unsigned _drawSetting{0};
+public:
+    const TalonSteps& Steps(unsigned wasteSize, unsigned stockSize,
+                            unsigned drawSetting, unsigned maxRecycles) noexcept
+    {
+        assert(wasteSize <= MaxSize && stockSize <= MaxSize && maxRecycles <= 1);
+        if (drawSetting != _drawSetting) {
+            for (auto& entry: _entries) entry._filled = false;
+            _drawSetting = drawSetting;
+        }
+        Entry& entry = _entries[(wasteSize*(MaxSize+1) + stockSize)*2 + maxRecycles];
+        if (!entry._filled) {
+            entry._steps = SimulateTalon(wasteSize, stockSize, drawSetting, maxRecycles);
+            entry._filled = true;
+        }
+        return entry._steps;
+    }
+};
+
+const TalonSteps& CachedTalonSteps(unsigned wasteSize, unsigned stockSize,
+                         unsigned drawSetting, unsigned maxRecycles) noexcept
+{
+    static thread_local TalonStepCache cache;
+    return cache.Steps(wasteSize, stockSize, drawSetting, maxRecycles);
+}
+}   // namespace KSolveNames
@@ -0,0 +1,121 @@
+// Talon.hpp declares TalonCards(), which finds the cards that can be
+// played from the talon (the stock and waste piles) and how to reach
+// them.  It is a template so that any game representation offering
+// WastePile(), StockPile(), DrawSetting(), RecycleLimit(),
+// RecycleCount() and TalonLookAhead() can use it.  Talon.cpp
+// implements the rest.
+#ifndef TALON_HPP
+#define TALON_HPP
+
+#include "Game.hpp"
+
+namespace KSolveNames {
+
+struct TalonFuture {
+    Card _card;
+    unsigned short _nMoves;
+    signed short _drawCount;
+    bool _recycle;
+
+    TalonFuture(const Card& card, unsigned nMoves, int draw, bool recycle)
+        : _card(card)
+        , _nMoves(nMoves)
+        , _drawCount(draw)
+        , _recycle(recycle)
+        {}
+};
+
+// The positions TalonCards() visits in the talon depend only on the
+// sizes of the waste and stock piles, the draw setting, and whether
+// a recycle is allowed, not on the cards.  A TalonStep records one
+// such position by the size the waste pile would then have.
+struct TalonStep {
+    unsigned char _wasteSize;
+    unsigned char _nMoves;
+    bool _recycle;
+};
+typedef static_vector<TalonStep,MaxTalonLookAhead> TalonSteps;
+
+// Return the steps for a talon by simulating its draws and recycles.
+TalonSteps SimulateTalon(unsigned wasteSize, unsigned stockSize,
+                         unsigned drawSetting, unsigned maxRecycles) noexcept;
+
+// Return the same steps as SimulateTalon() from a per-thread 
+// cache.  The returned reference is good until the next call.
+const TalonSteps& CachedTalonSteps(unsigned wasteSize, unsigned stockSize,
+                         unsigned drawSetting, unsigned maxRecycles) noexcept;
+
+// The cards TalonCards() finds, produced one at a time as
+// they are visited, so a caller that stops early pays only
+// for the cards it has looked at.  It covers the first size
+// of the steps.
+class TalonCardRange
+{
+    const TalonSteps& _steps;
+    const PileVec& _waste;
+    const PileVec& _stock;
+    unsigned _size;
+
+    TalonFuture Future(TalonStep step) const noexcept
+    {
+        const unsigned wSize = step._wasteSize;
+        // The top card of the simulated waste pile
+        const Card card = (wSize <= _waste.size())
+            ? _waste[wSize-1]
+            : *(_stock.end()-(wSize-_waste.size()));
+        return TalonFuture(card, step._nMoves, 
+            int(wSize)-int(_waste.size()), step._recycle);
+    }
+public:
+    TalonCardRange(const TalonSteps& steps, const PileVec& waste, const PileVec& stock,
+                   unsigned size = MaxTalonLookAhead) noexcept
+        : _steps(steps)
+        , _waste(waste)
+        , _stock(stock)
+        , _size(std::min<unsigned>(size, steps.size()))
+        {}
+    class Iterator
+    {
+        const TalonStep* _step;
+        const TalonCardRange& _range;
+    public:
+        Iterator(const TalonStep* step, const TalonCardRange& range) noexcept
+            : _step(step)
+            , _range(range)
+            {}
+        TalonFuture operator*() const noexcept  {return _range.Future(*_step);}
+        Iterator& operator++() noexcept         {++_step; return *this;}
+        bool operator!=(const Iterator& other) const noexcept
+                                                {return _step != other._step;}
+    };
+    Iterator begin() const noexcept     {return Iterator(_steps.data(), *this);}
+    Iterator end() const noexcept       {return Iterator(_steps.data()+_size, *this);}
+    unsigned size() const noexcept      {return _size;}
+    // True if some steps are left out
+    bool Truncated() const noexcept     {return _size < _steps.size();}
+};
+
+// Return all the cards that can be played
+// from the talon (the stock and waste piles), along
+// with the number of moves required to reach each one
+// and the number of cards that must be drawn (or undrawn)
+// to reach each one.
+//
+// Enforces the limit on recycles and returns only the first
+// game.TalonLookAhead() cards.  R is as in Game::AvailableMoves().
+template <class R = RunTimeRules, class GameT>
+TalonCardRange TalonCards(const GameT & game) noexcept
+{
+    const PileVec& waste = game.WastePile();
+    const PileVec& stock = game.StockPile();
+    const unsigned draw = R::Draw ? R::Draw : game.DrawSetting();
+    const unsigned maxRecycles = R::RecycleLimited 
+        ? std::min(1U, game.RecycleLimit()-game.RecycleCount())
+        : 1U;
+    return TalonCardRange(
+        CachedTalonSteps(waste.size(), stock.size(), draw, maxRecycles),
+        waste, stock, game.TalonLookAhead());
+}
+}   // namespace KSolveNames
+
+#endif      // TALON_HPP
@@ -0,0 +1,165 @@
+// kernel-benchmark.cpp
+//
+// Times each set of kernels in Kernels.hpp that this processor can
+// run, on inputs taken from random games: the tableau codes of each
+// position, each face-up run for the major-suit bits, and each waste
+// pile and face-down part of a tableau pile for the misorder counts.
+// It also checks that every set gets the same results.
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <random>
+
+#include "Kernels.hpp"
+
+using namespace std;
+using namespace KSolveNames;
+
+struct Specs
+{
+    unsigned deals{1000};
+    unsigned moves{80};
+    unsigned reps{100};
+    unsigned seed{1};
+};
+
+static unsigned GetUnsignedInt(int argc, char* argv[], int i)
+{
+    if (i >= argc) {
+        cerr << "Missing argument after \"" << argv[i-1] << "\"\n";
+        exit(4);
+    }
+    try {
+        return stoul(argv[i]);
+    }
+    catch (...) {
+        cerr << "Invalid argument after \"" << argv[i-1] << "\": \"" << argv[i] << "\"\n";
+        exit(4);
+    }
+}
+
+static Specs GetSpecs(int argc, char* argv[])
+{
+    Specs result;
+    for (int i = 1; i < argc; ++i){
+        const string arg = argv[i];
+        if (arg == "-n" || arg == "--deals") {
+            result.deals = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-m" || arg == "--moves") {
+            result.moves = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-r" || arg == "--reps") {
+            result.reps = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-s" || arg == "--seed") {
+            result.seed = GetUnsignedInt(argc, argv, ++i);
+        } else {
+            cerr << "kernel-benchmark - times the kernels in Kernels.hpp\n\n";
+            cerr << "-n # or --deals #       Number of random deals to play (default 1000)\n";
+            cerr << "-m # or --moves #       Random MoveSpecs to make in each (default 80)\n";
+            cerr << "-r # or --reps #        Times to run each kernel on all the inputs (default 100)\n";
+            cerr << "-s # or --seed #        Seed for the deals and the moves (default 1)\n";
+            exit(4);
+        }
+    }
+    return result;
+}
+
+struct PileRun
+{
+    PileVec _pile;
+    unsigned _first;
+    unsigned _n;
+};
+
+struct Inputs
+{
+    vector<TableauCodeArray> _codes;
+    vector<PileRun> _faceUp;
+    vector<PileRun> _misorder;
+};
+
+static Inputs CollectInputs(const Specs& specs)
+{
+    Inputs result;
+    mt19937 rng(specs.seed);
+    for (unsigned seed = specs.seed; seed < specs.seed+specs.deals; ++seed) {
+        Game game(NumberedDeal(seed));
+        game.Deal();
+        Moves movesMade;
+        for (unsigned imv = 0; imv < specs.moves; ++imv) {
+            const QMoves avail = game.AvailableMoves(movesMade);
+            if (avail.empty()) break;
+            const MoveSpec mv = avail[rng()%avail.size()];
+            game.MakeMove(mv);
+            movesMade.push_back(mv);
+
+            result._codes.push_back(game.TableauCodes());
+            const PileVec& waste = game.WastePile();
+            result._misorder.push_back({waste, 0, unsigned(waste.size())});
+            for (const Pile& pile: game.Tableau()) {
+                if (pile.empty()) continue;
+                const unsigned first = pile.DownCount()+1;
+                result._faceUp.push_back({pile, first, unsigned(pile.size())-first});
+                result._misorder.push_back({pile, 0, first});
+            }
+        }
+    }
+    return result;
+}
+
+// Run f on each input reps times.  Return the sum of its results
+// and the nanoseconds per call.
+template <class Input, class Func>
+static pair<uint64_t,double> Time(const vector<Input>& inputs, unsigned reps, Func f)
+{
+    uint64_t sum = 0;
+    const auto startTime = chrono::steady_clock::now();
+    for (unsigned rep = 0; rep < reps; ++rep) {
+        for (const auto& input: inputs) {
+            sum += f(input);
+        }
+    }
+    const double elapsed = (chrono::steady_clock::now() - startTime)/1.0ns;
+    return {sum, elapsed/reps/inputs.size()};
+}
+
+int main(int argc, char* argv[])
+{
+    const Specs specs = GetSpecs(argc, argv);
+    const Inputs inputs = CollectInputs(specs);
+    cout << inputs._codes.size() << " code arrays, "
+         << inputs._faceUp.size() << " face-up runs, "
+         << inputs._misorder.size() << " misorder counts\n";
+    cout << "kernels\tsort ns\tmajor ns\tmisorder ns\n";
+    cout.precision(3);
+
+    vector<uint64_t> firstSums;
+    for (const Kernels* kernels: AvailableKernels()) {
+        const auto sort = Time(inputs._codes, specs.reps,
+            [kernels](const TableauCodeArray& codes) {
+                TableauCodeArray sorted;
+                kernels->_sortTableauCodes(codes, sorted);
+                return uint64_t(sorted[0]) + sorted[3] * 3 + sorted[6] * 7;
+            });
+        const auto major = Time(inputs._faceUp, specs.reps,
+            [kernels](const PileRun& run) {
+                return kernels->_majorSuitBits(run._pile, run._first, run._n);
+            });
+        const auto misorder = Time(inputs._misorder, specs.reps,
+            [kernels](const PileRun& run) {
+                return kernels->_misorderCount(run._pile, run._n);
+            });
+        cout << kernels->_name << "\t" << sort.second << "\t" << major.second
+             << "\t" << misorder.second << "\n";
+
+        const vector<uint64_t> sums{sort.first, major.first, misorder.first};
+        if (firstSums.empty()) {
+            firstSums = sums;
+        } else if (sums != firstSums) {
+            cerr << "The " << kernels->_name << " kernels disagree with the scalar ones\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,277 @@
+// movegen-check.cpp
+//
+// A differential test of BitGame's move generator against Game's, the
+// reference.  It plays a random walk from each of a range of ran deals
+// in both at once, and at each position checks that
+//  - both offer the same moves,
+//  - making and unmaking each of those moves returns each to the
+//    position it started from, and in Game, to the same Hash(),
+//  - after the walk's move, both hold the same cards, and
+//  - Game's Hash(), GameState key and MinimumMovesLeft() match those
+//    of a Game built afresh from the position, so anything Game keeps
+//    up to date move by move agrees with what is computed from scratch.
+// BitGame keeps no key or heuristic of its own, so matching Game's
+// position means matching those.  Then it replays the walks in each
+// alone and reports how fast each generates, makes and unmakes moves.
+// It exits with 1 if any check failed.
+//
+// To check another move generator, give it BitGame's interface and
+// a PositionOf() overload, and add it next to BitGame in main().
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <random>
+
+#include "KSolveAStar.hpp"
+#include "GameStateMemory.hpp"
+#include "BitGame.hpp"
+
+using namespace std;
+using namespace KSolveNames;
+
+struct Specs
+{
+    unsigned deals{25000};
+    unsigned moves{200};
+    unsigned seed{1};
+    unsigned draw{1};
+    bool vegas{false};
+};
+
+static unsigned GetUnsignedInt(int argc, char* argv[], int i)
+{
+    if (i >= argc) {
+        cerr << "Missing argument after \"" << argv[i-1] << "\"\n";
+        exit(4);
+    }
+    try {
+        return stoul(argv[i]);
+    }
+    catch (...) {
+        cerr << "Invalid argument after \"" << argv[i-1] << "\": \"" << argv[i] << "\"\n";
+        exit(4);
+    }
+}
+
+static Specs GetSpecs(int argc, char* argv[])
+{
+    Specs result;
+    for (int i = 1; i < argc; ++i){
+        const string arg = argv[i];
+        if (arg == "-n" || arg == "--deals") {
+            result.deals = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-m" || arg == "--moves") {
+            result.moves = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-s" || arg == "--seed") {
+            result.seed = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-d" || arg == "--draw") {
+            result.draw = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-v" || arg == "--vegas") {
+            result.vegas = true;
+        } else {
+            cerr << "movegen-check - checks BitGame's move generator against Game's and times both\n\n";
+            cerr << "-n # or --deals #       Number of deals to walk (default 25000)\n";
+            cerr << "-m # or --moves #       Most MoveSpecs to make in each (default 200)\n";
+            cerr << "-s # or --seed #        First ran seed, also the seed for the moves (default 1)\n";
+            cerr << "-d # or --draw #        Cards to draw from the stock (default 1)\n";
+            cerr << "-v or --vegas           Limit passes through the stock to the draw number\n";
+            exit(4);
+        }
+    }
+    return result;
+}
+
+// static_vector's copy assignment is implicitly declared beside a
+// user-provided copy constructor, which is deprecated, so these 
+// copy the cards with assign().
+static GamePosition PositionOf(const Game& game)
+{
+    GamePosition result;
+    result._waste.assign(game.WastePile().begin(), game.WastePile().end());
+    result._stock.assign(game.StockPile().begin(), game.StockPile().end());
+    for (unsigned i = 0; i < TableauSize; ++i) {
+        const Pile& pile = game.Tableau()[i];
+        result._tableau[i].assign(pile.begin(), pile.end());
+        result._downCount[i] = pile.DownCount();
+    }
+    for (unsigned suit = 0; suit < SuitsPerDeck; ++suit) {
+        result._foundationSizes[suit] = game.Foundation()[suit].size();
+    }
+    result._recycleCount = game.RecycleCount();
+    return result;
+}
+
+static GamePosition PositionOf(const BitGame& game)
+{
+    GamePosition result;
+    result._waste.assign(game.WastePile().begin(), game.WastePile().end());
+    result._stock.assign(game.StockPile().begin(), game.StockPile().end());
+    for (unsigned i = 0; i < TableauSize; ++i) {
+        const PileCodeT pile = PileCodeT(TableauBase+i);
+        result._tableau[i] = game.Cards(pile);
+        result._downCount[i] = result._tableau[i].size() - game.UpCount(pile);
+    }
+    for (unsigned suit = 0; suit < SuitsPerDeck; ++suit) {
+        result._foundationSizes[suit] = game.Cards(PileCodeT(FoundationBase+suit)).size();
+    }
+    result._recycleCount = game.RecycleCount();
+    return result;
+}
+
+// What making and unmaking a move must leave unchanged
+struct Fingerprint
+{
+    GamePosition _position;
+    uint64_t _hash{0};
+    bool operator==(const Fingerprint&) const = default;
+};
+static Fingerprint FingerprintOf(const Game& game)
+{
+    return {PositionOf(game), game.Hash()};
+}
+static Fingerprint FingerprintOf(const BitGame& game)
+{
+    return {PositionOf(game), 0};
+}
+
+// The moves in a form that does not depend on their order
+static vector<string> MoveSet(const QMoves& moves)
+{
+    vector<string> result;
+    for (auto mv: moves) result.push_back(Peek(mv));
+    ranges::sort(result);
+    return result;
+}
+
+// Make and unmake each of moves in game.  Return the first that
+// does not return it to where it started, if any.
+template <class GameT>
+static optional<MoveSpec> RoundTrips(GameT& game, const QMoves& moves)
+{
+    const Fingerprint before = FingerprintOf(game);
+    for (auto mv: moves) {
+        game.MakeMove(mv);
+        game.UnMakeMove(mv);
+        if (FingerprintOf(game) != before) return mv;
+    }
+    return nullopt;
+}
+
+// Return what is wrong with ref's position after a move, if anything
+static string StateError(const Game& ref, const GamePosition& position)
+{
+    const string error = PositionError(position);
+    if (error.size()) return error;
+    const Game fresh(position, ref.DrawSetting(), ref.RecycleLimit());
+    if (fresh.Hash() != ref.Hash())
+        return "Hash() differs from a fresh Game's";
+    if (!(GameState(fresh, 0) == GameState(ref, 0)))
+        return "GameState differs from a fresh Game's";
+    if (MinimumMovesLeft(fresh) != MinimumMovesLeft(ref))
+        return "MinimumMovesLeft() differs from a fresh Game's";
+    return string();
+}
+
+// Walk a deal in ref and opt at once, checking them as they go.
+// Append the walk's moves to walk.  Return false if a check failed.
+template <class GameT>
+static bool Walk(const Specs& specs, unsigned seed, mt19937& rng, Moves& walk)
+{
+    const unsigned recycleLimit = specs.vegas ? specs.draw-1 : -1;
+    Game ref(NumberedDeal(seed), specs.draw, recycleLimit);
+    GameT opt(NumberedDeal(seed), specs.draw, recycleLimit);
+    auto Fail = [&](const string& what) {
+        cout << "seed " << seed << ", after " << walk.size() << " MoveSpecs: "
+             << what << "\n" << Peek(ref);
+        return false;
+    };
+    for (unsigned step = 0; step < specs.moves; ++step) {
+        const QMoves refMoves = ref.AvailableMoves(walk);
+        const QMoves optMoves = opt.AvailableMoves(walk);
+        if (MoveSet(refMoves) != MoveSet(optMoves))
+            return Fail("different moves");
+        if (auto mv = RoundTrips(ref, refMoves))
+            return Fail("Game did not unmake " + Peek(*mv));
+        if (auto mv = RoundTrips(opt, optMoves))
+            return Fail("the other did not unmake " + Peek(*mv));
+        if (refMoves.empty()) break;
+
+        const MoveSpec mv = refMoves[rng()%refMoves.size()];
+        ref.MakeMove(mv);
+        opt.MakeMove(mv);
+        walk.push_back(mv);
+        const GamePosition position = PositionOf(ref);
+        if (position != PositionOf(opt))
+            return Fail("different positions after " + Peek(mv));
+        const string error = StateError(ref, position);
+        if (error.size())
+            return Fail(error);
+    }
+    return true;
+}
+
+struct Timing
+{
+    uint64_t _positions{0};
+    uint64_t _moves{0};         // moves generated, each made and unmade
+    double _seconds{0};
+};
+
+// Replay each walk in a GameT, generating the moves at each position
+// and making and unmaking each of them.
+template <class GameT>
+static Timing Time(const Specs& specs, const vector<Moves>& walks)
+{
+    const unsigned recycleLimit = specs.vegas ? specs.draw-1 : -1;
+    vector<GameT> games;
+    for (unsigned i = 0; i < walks.size(); ++i) 
+        games.emplace_back(NumberedDeal(specs.seed+i), specs.draw, recycleLimit);
+
+    Timing result;
+    const auto startTime = chrono::steady_clock::now();
+    for (unsigned i = 0; i < walks.size(); ++i) {
+        GameT& game = games[i];
+        Moves movesMade;
+        for (auto mv: walks[i]) {
+            const QMoves moves = game.AvailableMoves(movesMade);
+            for (auto m: moves) {
+                game.MakeMove(m);
+                game.UnMakeMove(m);
+            }
+            result._positions += 1;
+            result._moves += moves.size();
+            game.MakeMove(mv);
+            movesMade.push_back(mv);
+        }
+    }
+    result._seconds = (chrono::steady_clock::now() - startTime)/1.0s;
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    const Specs specs = GetSpecs(argc, argv);
+    mt19937 rng(specs.seed);
+    vector<Moves> walks(specs.deals);
+    unsigned failures = 0;
+    for (unsigned i = 0; i < specs.deals; ++i) {
+        failures += !Walk<BitGame>(specs, specs.seed+i, rng, walks[i]);
+    }
+
+    const Timing ref = Time<Game>(specs, walks);
+    const Timing opt = Time<BitGame>(specs, walks);
+    cout << ref._positions << " positions checked, " << failures << " deals failed\n";
+    cout << "generator\tpositions/s\tmoves/s\n";
+    cout.precision(3);
+    for (auto [name, t]: {pair{"Game", ref}, pair{"BitGame", opt}}) {
+        cout << name << "\t\t" << t._positions/t._seconds << "\t\t" 
+             << t._moves/t._seconds << "\n";
+    }
+    if (ref._moves != opt._moves) {
+        cerr << "Game and BitGame generated different numbers of moves\n";
+        failures += 1;
+    }
+    return failures ? 1 : 0;
+}
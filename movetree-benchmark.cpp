@@ -0,0 +1,139 @@
+// movetree-benchmark.cpp
+//
+// Measures how fast move sequences can be loaded from big move trees
+// in each of the layouts defined in MoveTree.hpp.
+//
+// It builds the same synthetic tree in each layout.  The tree has a
+// fixed number of levels, and each stem's parent is chosen at random
+// from the level above, so that, as in a real search, walking from a
+// leaf to the root touches memory all over the tree.  Most stems hold
+// one MoveSpec; a few hold several, about as in draw-1 searches.
+//
+// It then loads the sequences leading to many randomly chosen leaves
+// and reports the rate in sequences and MoveSpecs per second.
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <random>
+
+#include "MoveTree.hpp"
+#include "frystl/static_deque.hpp"
+
+using namespace std;
+using namespace KSolveNames;
+
+using SequenceType = MoveCounter<static_deque<MoveSpec,500>>;
+
+struct Specs
+{
+    unsigned moveSpecs{100'000'000};
+    unsigned levels{150};
+    unsigned loads{1'000'000};
+    unsigned seed{1};
+};
+
+static unsigned GetUnsignedInt(int argc, char* argv[], int i)
+{
+    if (i >= argc) {
+        cerr << "Missing argument after \"" << argv[i-1] << "\"\n";
+        exit(4);
+    }
+    try {
+        return stoul(argv[i]);
+    }
+    catch (...) {
+        cerr << "Invalid argument after \"" << argv[i-1] << "\": \"" << argv[i] << "\"\n";
+        exit(4);
+    }
+}
+
+static Specs GetSpecs(int argc, char* argv[])
+{
+    Specs result;
+    for (int i = 1; i < argc; ++i){
+        const string arg = argv[i];
+        if (arg == "-m" || arg == "--movespecs") {
+            result.moveSpecs = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-l" || arg == "--levels") {
+            result.levels = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-n" || arg == "--loads") {
+            result.loads = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-s" || arg == "--seed") {
+            result.seed = GetUnsignedInt(argc, argv, ++i);
+        } else {
+            cerr << "movetree-benchmark - times loading move sequences from big move trees\n\n";
+            cerr << "-m # or --movespecs #   MoveSpecs in the tree (default 100 million)\n";
+            cerr << "-l # or --levels #      Stems in each path from a leaf to the root (default 150)\n";
+            cerr << "-n # or --loads #       Number of sequences to load (default 1 million)\n";
+            cerr << "-s # or --seed #        Random number seed (default 1)\n";
+            exit(4);
+        }
+    }
+    return result;
+}
+
+// Build a tree in the given layout.  Returns the indexes of the stems
+// at the deepest level.
+template <class Tree>
+static vector<MoveX> BuildTree(Tree& tree, const Specs& specs)
+{
+    mt19937 rng(specs.seed);
+    const MoveSpec move(Tableau1, Tableau2, 1, false);
+    static_vector<MoveSpec,8> stem;
+    typename Tree::Buffer buffer;
+    vector<MoveX> prevLevel{-1U};
+    vector<MoveX> level;
+    vector<MoveX> local;
+    tree.Reserve(specs.moveSpecs+1000);
+    const unsigned perLevel = specs.moveSpecs/specs.levels;
+    for (unsigned l = 0; l < specs.levels; ++l) {
+        level.clear();
+        for (unsigned n = 0; n < perLevel; ) {
+            buffer.clear();
+            local.clear();
+            // Flush in blocks like MoveStorage does
+            while (buffer.MoveSpecCount() < 200 && n < perLevel) {
+                stem.assign(rng()%10 ? 1 : 2 + rng()%5, move);
+                local.push_back(buffer.Push(prevLevel[rng()%prevLevel.size()], stem));
+                n += stem.size();
+            }
+            const MoveX base = tree.Append(buffer);
+            for (MoveX ix: local) level.push_back(ix+base);
+        }
+        swap(level, prevLevel);
+    }
+    return prevLevel;
+}
+
+template <class Tree>
+static void Measure(const char* name, const Specs& specs)
+{
+    Tree tree;
+    const auto leaves = BuildTree(tree, specs);
+    mt19937 rng(specs.seed+1);
+    SequenceType sequence;
+    uint64_t moveSpecsLoaded = 0;
+
+    auto startTime = chrono::steady_clock::now();
+    for (unsigned i = 0; i < specs.loads; ++i) {
+        LoadStems(tree, leaves[rng()%leaves.size()], sequence);
+        moveSpecsLoaded += sequence.size();
+    }
+    double elapsed = (chrono::steady_clock::now() - startTime)/1.0s;
+
+    cout << name
+         << ": tree " << tree.SizeInBytes()/1e6 << " MB, "
+         << specs.loads/elapsed/1e6 << " million sequences/sec., "
+         << moveSpecsLoaded/elapsed/1e6 << " million MoveSpecs/sec.\n";
+}
+
+int main(int argc, char* argv[])
+{
+    const Specs specs = GetSpecs(argc, argv);
+    cout.precision(4);
+    Measure<PackedMoveTree>("Packed", specs);
+    Measure<SplitMoveTree>("Split ", specs);
+    return 0;
+}
@@ -0,0 +1,140 @@
+// perft.cpp
+//
+// Measures the speed of the move generator apart from the search.
+// Modelled on the chess program test of the same name, it counts
+// the positions reachable from a deal in a given number of MoveSpecs
+// using only AvailableMoves() (including XYZ_Filter()), MakeMove()
+// and UnMakeMove(), and reports how many MoveSpecs it made per second.
+//
+// The counts also serve as a regression test: a change that only
+// makes the move generator faster must not change them.  With -b, it
+// runs the same counts through BitGame, which must give the same ones.
+// With -x, XYZ_Filter() scans a plain vector of the moves made instead
+// of using the LastTouchSequence the solver uses.
+
+#include <string>
+#include <iostream>
+#include <chrono>
+
+#include "Game.hpp"
+#include "BitGame.hpp"
+
+using namespace std;
+using namespace KSolveNames;
+
+struct Specs
+{
+    unsigned depth{8};
+    unsigned seed{1};
+    unsigned nDeals{10};
+    unsigned draw{1};
+    bool bitGame{false};
+    bool scan{false};
+};
+
+static unsigned GetUnsignedInt(int argc, char* argv[], int i)
+{
+    if (i >= argc) {
+        cerr << "Missing argument after \"" << argv[i-1] << "\"\n";
+        exit(4);
+    }
+    try {
+        return stoul(argv[i]);
+    }
+    catch (...) {
+        cerr << "Invalid argument after \"" << argv[i-1] << "\": \"" << argv[i] << "\"\n";
+        exit(4);
+    }
+}
+
+static Specs GetSpecs(int argc, char* argv[])
+{
+    Specs result;
+    for (int i = 1; i < argc; ++i){
+        const string arg = argv[i];
+        if (arg == "-d" || arg == "--depth") {
+            result.depth = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-s" || arg == "--seed") {
+            result.seed = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-n" || arg == "--deals") {
+            result.nDeals = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-dc" || arg == "--draw") {
+            result.draw = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-b" || arg == "--bitgame") {
+            result.bitGame = true;
+        } else if (arg == "-x" || arg == "--scan") {
+            result.scan = true;
+        } else {
+            cerr << "perft - counts positions reachable by the move generator\n\n";
+            cerr << "-d # or --depth #       Number of MoveSpecs to look ahead (default 8)\n";
+            cerr << "-s # or --seed #        Seed of the first deal, as in ran and KSolve -ran (default 1)\n";
+            cerr << "-n # or --deals #       Number of deals, with consecutive seeds (default 10)\n";
+            cerr << "-dc # or --draw #       Cards to draw from the stock (default 1)\n";
+            cerr << "-b or --bitgame         Use BitGame instead of Game\n";
+            cerr << "-x or --scan            Keep the moves made in a vector, as unittests does\n";
+            exit(4);
+        }
+    }
+    return result;
+}
+
+// Return the number of positions reachable from the current one in
+// exactly depth MoveSpecs, counting a position once for each path to it.
+// A position with no moves counts only if depth is zero.  Adds the
+// number of MoveSpecs made to nMade.
+template <class GameT, class SequenceT>
+static uint64_t Perft(GameT& game, SequenceT& movesMade, unsigned depth, uint64_t& nMade) noexcept
+{
+    if (depth == 0) return 1;
+    const QMoves moves = game.AvailableMoves(movesMade);
+    uint64_t result = 0;
+    nMade += moves.size();
+    for (const auto mv: moves) {
+        // A dominant move comes alone and may leave others cached for
+        // the next call.  Moves from a choice must each start clean.
+        if (moves.size() > 1) game.ClearMoveCache();
+        game.MakeMove(mv);
+        movesMade.push_back(mv);
+        result += Perft(game, movesMade, depth-1, nMade);
+        movesMade.pop_back();
+        game.UnMakeMove(mv);
+    }
+    return result;
+}
+
+template <class GameT, class SequenceT>
+static void Run(const Specs& specs)
+{
+    uint64_t total = 0;
+    uint64_t nMade = 0;
+    auto startTime = chrono::steady_clock::now();
+    for (unsigned seed = specs.seed; seed < specs.seed+specs.nDeals; ++seed) {
+        GameT game(NumberedDeal(seed), specs.draw);
+        SequenceT movesMade;
+        const uint64_t count = Perft(game, movesMade, specs.depth, nMade);
+        cout << seed << "\t" << count << "\n";
+        total += count;
+    }
+    double elapsed = (chrono::steady_clock::now() - startTime)/1.0s;
+    cout << "Total\t" << total << "\n";
+    cout << nMade/elapsed/1e6 << " million MoveSpecs made/sec.\n";
+}
+
+int main(int argc, char* argv[])
+{
+    const Specs specs = GetSpecs(argc, argv);
+    cout.precision(4);
+    using Tracked = LastTouchSequence<500>;
+    if (specs.depth > 500) {
+        cerr << "Depth must not exceed 500\n";
+        return 4;
+    }
+    if (specs.bitGame) {
+        if (specs.scan) Run<BitGame,Moves>(specs);
+        else            Run<BitGame,Tracked>(specs);
+    } else {
+        if (specs.scan) Run<Game,Moves>(specs);
+        else            Run<Game,Tracked>(specs);
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+// prune-check.cpp
+//
+// Checks the pruning rules (see PruneRule in Game.hpp) for soundness.  It solves
+// each deal of a corpus with all the rules and again with each rule left
+// out in turn.  A sound rule never changes the length of a minimum
+// solution or turns a solvable deal impossible.  For each rule it
+// reports any deals where it did, and how many advances and closed-list
+// states the rule saves.  It exits with 1 if any rule failed.
+//
+// The corpus is either consecutive ran seeds or the seeds in the second
+// column of a file written by ran, such as those in tests/.
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "KSolveAStar.hpp"
+
+using namespace std;
+using namespace KSolveNames;
+
+struct Specs
+{
+    unsigned deals{10};
+    unsigned seed{1};
+    unsigned draw{1};
+    unsigned mvLimit{10'000'000};
+    unsigned threads{0};
+    bool vegas{false};
+    string file;
+};
+
+static unsigned GetUnsignedInt(int argc, char* argv[], int i)
+{
+    if (i >= argc) {
+        cerr << "Missing argument after \"" << argv[i-1] << "\"\n";
+        exit(4);
+    }
+    try {
+        return stoul(argv[i]);
+    }
+    catch (...) {
+        cerr << "Invalid argument after \"" << argv[i-1] << "\": \"" << argv[i] << "\"\n";
+        exit(4);
+    }
+}
+
+static Specs GetSpecs(int argc, char* argv[])
+{
+    Specs result;
+    for (int i = 1; i < argc; ++i){
+        const string arg = argv[i];
+        if (arg == "-n" || arg == "--deals") {
+            result.deals = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-s" || arg == "--seed") {
+            result.seed = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-d" || arg == "--draw") {
+            result.draw = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-mv" || arg == "--mvlimit") {
+            result.mvLimit = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-t" || arg == "--threads") {
+            result.threads = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-v" || arg == "--vegas") {
+            result.vegas = true;
+        } else if ((arg == "-f" || arg == "--file") && i+1 < argc) {
+            result.file = argv[++i];
+        } else {
+            cerr << "prune-check - checks that each pruning rule keeps solutions minimal\n\n";
+            cerr << "-n # or --deals #       Number of deals to solve (default 10)\n";
+            cerr << "-s # or --seed #        First ran seed (default 1)\n";
+            cerr << "-f file or --file file  Solve the seeds in a file written by ran instead,\n";
+            cerr << "                        the first n of them\n";
+            cerr << "-d # or --draw #        Cards to draw from the stock (default 1)\n";
+            cerr << "-v or --vegas           Limit passes through the stock to the draw number\n";
+            cerr << "-mv # or --mvlimit #    Maximum size of the move tree (default 10 million)\n";
+            cerr << "-t # or --threads #     Threads (default: as many as the hardware runs)\n";
+            exit(4);
+        }
+    }
+    return result;
+}
+
+static vector<unsigned> Seeds(const Specs& specs)
+{
+    vector<unsigned> result;
+    if (specs.file.empty()) {
+        for (unsigned i = 0; i < specs.deals; ++i)
+            result.push_back(specs.seed+i);
+        return result;
+    }
+    ifstream file(specs.file);
+    if (!file) {
+        cerr << "Could not open \"" << specs.file << "\"\n";
+        exit(4);
+    }
+    string line;
+    while (result.size() < specs.deals && getline(file, line)) {
+        istringstream fields(line);
+        string row, seed;
+        fields >> row >> seed;
+        if (seed.size() && isdigit(seed[0]))      // skip the header
+            result.push_back(stoul(seed));
+    }
+    return result;
+}
+
+struct Totals
+{
+    unsigned compared{0};       // deals both runs finished
+    unsigned failures{0};
+    uint64_t advances{0};       // with the rule left out
+    uint64_t closed{0};
+    uint64_t advancesAll{0};    // with all the rules, same deals
+    uint64_t closedAll{0};
+};
+
+static bool Finished(KSolveAStarCode code) noexcept
+{
+    return code == SolvedMinimal || code == Impossible;
+}
+
+int main(int argc, char* argv[])
+{
+    const Specs specs = GetSpecs(argc, argv);
+    const vector<unsigned> seeds = Seeds(specs);
+    array<Totals,PruneRuleNames.size()> totals;
+
+    for (unsigned seed: seeds) {
+        Game game(NumberedDeal(seed), specs.draw, specs.vegas ? specs.draw-1 : -1);
+        const auto all = KSolveAStar(game, specs.mvLimit, specs.threads);
+        if (!Finished(all._code)) {
+            cout << "seed " << seed << ": gave up with all rules\n";
+            continue;
+        }
+        for (unsigned r = 0; r < totals.size(); ++r) {
+            const auto without = KSolveAStar(game, specs.mvLimit, specs.threads,
+                                             "", MaxTalonLookAhead, 1U << r);
+            if (!Finished(without._code)) {
+                cout << "seed " << seed << ": gave up without " << PruneRuleNames[r] << "\n";
+                continue;
+            }
+            Totals& t = totals[r];
+            t.compared += 1;
+            t.advances += without._advances;
+            t.closed += without._stateCount;
+            t.advancesAll += all._advances;
+            t.closedAll += all._stateCount;
+            const unsigned allMoves = MoveCount(all._solution);
+            const unsigned withoutMoves = MoveCount(without._solution);
+            if (all._code != without._code || allMoves != withoutMoves) {
+                t.failures += 1;
+                cout << "seed " << seed << ": without " << PruneRuleNames[r]
+                     << ", " << withoutMoves << " moves; with all rules, "
+                     << allMoves << "\n";
+            }
+        }
+    }
+
+    cout << "rule\tdeals\tfailures\tadvances saved\tclosed saved\n";
+    cout.precision(3);
+    bool ok = true;
+    for (unsigned r = 0; r < totals.size(); ++r) {
+        const Totals& t = totals[r];
+        auto Saved = [](uint64_t without, uint64_t all) {
+            return without ? 100. * (double(without) - double(all)) / without : 0.;
+        };
+        cout << PruneRuleNames[r] << "\t" << t.compared << "\t" << t.failures << "\t"
+             << Saved(t.advances, t.advancesAll) << "%\t"
+             << Saved(t.closed, t.closedAll) << "%\n";
+        ok = ok && t.failures == 0;
+    }
+    return ok ? 0 : 1;
+}
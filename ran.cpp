@@ -3,6 +3,8 @@
 
 #include <iostream>			// cout
 #include <string>
+#include <sstream>
+#include <vector>
 #include <cstdint>
 #include <chrono>
 #include "KSolveAStar.hpp"
@@ -21,6 +23,11 @@ struct Specification
     uint32_t _seed0;
     int _incr;
     bool _vegas;
+    string _moveTreeDirectory;
+    unsigned _talonLookAhead;
+    unsigned _heuristic;
+    unsigned _heuristicB;   // with _compare
+    bool _compare;
 };
 
 void Error(string msg)
@@ -40,6 +47,24 @@ int GetNumber(string arg)
     return result;
 }
 
+// Parse "all", "none", or a comma-separated list of HeuristicTermNames
+unsigned GetHeuristic(string arg)
+{
+    if (arg == "all") return FullHeuristic;
+    if (arg == "none") return 0;
+    unsigned result{0};
+    istringstream names(arg);
+    string name;
+    while (getline(names, name, ',')) {
+        unsigned i = 0;
+        while (i < HeuristicTermNames.size() && name != HeuristicTermNames[i]) 
+            ++i;
+        if (i == HeuristicTermNames.size()) Error("Unknown heuristic term " + name);
+        result |= 1U << i;
+    }
+    return result;
+}
+
 Specification GetSpec(int argc, char * argv[])
 {
     Specification spec;
@@ -53,6 +78,10 @@ Specification GetSpec(int argc, char * argv[])
     spec._drawSpec = 1;
     spec._threads = 0;
     spec._vegas = false;
+    spec._talonLookAhead = MaxTalonLookAhead;
+    spec._heuristic = FullHeuristic;
+    spec._heuristicB = FullHeuristic;
+    spec._compare = false;
 
     for (int iarg = 1; iarg < argc; iarg += 1) {
         string flag = argv[iarg];
@@ -68,6 +97,11 @@ Specification GetSpec(int argc, char * argv[])
             cout << "-v or --vegas         Use the Vegas rule - limit passes to the draw number" << endl;
             cout << "-mv # or --mvlimit #  Set the maximum size of the move tree (default 30 million)." << endl;
             cout << "-t # or --threads #   Sets the number of threads (see below for default)." << endl;
+            cout << "-md dir or --mapdir dir  Keep the move tree in a temporary file in directory dir." << endl;
+            cout << "-f # or --fast #      Limits talon look-ahead to # cards, 1 to 24 (default 24)." << endl;
+            cout << "-hr h or --heuristic h  Counts only the heuristic terms in h (default all)." << endl;
+            cout << "-ab h1 h2 or --compare h1 h2  Solves each deal with heuristic h1 and then h2" << endl;
+            cout << "                      and compares them (see below)." << endl;
             cout << "The default number of threads is the number the hardware will run concurrently." << endl;
             cout << "The output on standard out is a tab-delimited file." << endl;
             cout << "Its columns are the row number, the seed, the number of threads," << endl;
@@ -76,9 +110,17 @@ Specification GetSpec(int argc, char * argv[])
             cout << "the number of talon passes in the solution if a solution is found." << endl;
             cout << "the clock time required in seconds, the final size of the fringe," << endl;
             cout << "the number of elements taken from the fringe (advances), "<< endl;
-            cout << "and the final size of the move tree." << endl;
+            cout << "the final size of the move tree, and the size of the closed list." << endl;
+            cout << "Builds with KSOLVE_RESTORE_CACHE add the restore cache hits and misses." << endl;
             cout << "Result codes: 0 = minimum solution found, 1 = some solution found, " << endl;
             cout << "              2 = impossible, 3 = --mvlimit exceeded." << endl;
+            cout << "A heuristic is \"all\", \"none\", or a comma-separated list of the terms" << endl;
+            cout << "tableau, cross-pile and talon.  With --compare, each line has the row" << endl;
+            cout << "number, the seed, the draw number, and the outcome, moves, time, advances" << endl;
+            cout << "and closed list size for each heuristic.  Lines starting with # at the" << endl;
+            cout << "end total the deals both finished and list any rows where their minimum" << endl;
+            cout << "solutions differ, which means a heuristic is not consistent.  Then" << endl;
+            cout << "ran exits with 1." << endl;
             cout << flush;
             exit(0);
         } else if (flag == "-s" || flag == "--seed") {
@@ -111,6 +153,26 @@ Specification GetSpec(int argc, char * argv[])
             iarg += 1;
             if (iarg == argc) Error("No number after "+flag);
             spec._threads = GetNumber(argv[iarg]);
+        } else if (flag == "-md" || flag == "--mapdir") {
+            iarg += 1;
+            if (iarg == argc) Error("No directory after "+flag);
+            spec._moveTreeDirectory = argv[iarg];
+        } else if (flag == "-f" || flag == "--fast") {
+            iarg += 1;
+            if (iarg == argc) Error("No number after "+flag);
+            const int n = GetNumber(argv[iarg]);
+            if (n < 1 || n > int(MaxTalonLookAhead)) Error(flag+" requires a number from 1 to 24");
+            spec._talonLookAhead = n;
+        } else if (flag == "-hr" || flag == "--heuristic") {
+            iarg += 1;
+            if (iarg == argc) Error("No heuristic after "+flag);
+            spec._heuristic = GetHeuristic(argv[iarg]);
+        } else if (flag == "-ab" || flag == "--compare") {
+            if (iarg+2 >= argc) Error("Two heuristics must follow "+flag);
+            spec._heuristic = GetHeuristic(argv[iarg+1]);
+            spec._heuristicB = GetHeuristic(argv[iarg+2]);
+            spec._compare = true;
+            iarg += 2;
         } else {
             Error ("Expected flag, got " + flag);
         }
@@ -118,16 +180,127 @@ Specification GetSpec(int argc, char * argv[])
     return spec;
 }
 
+// Warn once if the move tree could not be kept in a file in the
+// directory given with --mapdir.
+static void CheckMapping(const Specification& spec, const KSolveAStarResult& result)
+{
+    static bool warned = false;
+    if (spec._moveTreeDirectory.size() && !result._moveTreeMapped && !warned) {
+        cerr << "Unable to map a file in " << spec._moveTreeDirectory
+             << ". Using main memory." << endl;
+        warned = true;
+    }
+}
+
+// Both finished if each proved its solution minimal or the deal impossible
+static bool Finished(KSolveAStarCode code)
+{
+    return code == SolvedMinimal || code == Impossible;
+}
+
+// Solve each deal with spec._heuristic and then spec._heuristicB and
+// write a line comparing them, then the totals.  Return 1 if their
+// minimum solutions ever differ.
+int Compare(const Specification& spec, unsigned recycleLimit)
+{
+    const array<unsigned,2> heuristics{spec._heuristic, spec._heuristicB};
+    array<uint64_t,2> advances{}, closed{};
+    array<double,2> times{};
+    unsigned bothFinished{0};
+    vector<unsigned> mismatches, onlyA, onlyB;
+
+    if (spec._begin == 1) {
+        cout << "row\tseed\tdraw";
+        for (const char* ab: {"A", "B"}) {
+            for (const char* column: {"outcome", "moves", "time", "advances", "closed"})
+                cout << "\t" << column << ab;
+        }
+        cout << endl;
+    }
+    cout.precision(4);
+    unsigned seed = spec._seed0;
+    for (unsigned sample = spec._begin; sample <= spec._end; ++sample){
+        Game game(NumberedDeal(seed), spec._drawSpec, recycleLimit);
+        cout << sample << "\t" << seed << "\t" << spec._drawSpec << flush;
+        array<KSolveAStarCode,2> codes;
+        array<unsigned,2> moves;
+        array<uint64_t,2> dealAdvances, dealClosed;
+        array<double,2> dealTimes;
+        for (unsigned i = 0; i < 2; ++i) {
+            auto startTime = steady_clock::now();
+            KSolveAStarResult result = KSolveAStar(game,spec._mvLimit,spec._threads,
+                spec._moveTreeDirectory,spec._talonLookAhead,0,heuristics[i]);
+            duration<double> elapsed = steady_clock::now() - startTime;
+            CheckMapping(spec, result);
+            if (result._solution.size()) 
+                TestSolution(game, result._solution);
+            codes[i] = result._code;
+            moves[i] = MoveCount(result._solution);
+            dealAdvances[i] = result._advances;
+            dealClosed[i] = result._stateCount;
+            dealTimes[i] = elapsed.count();
+            cout << "\t" << result._code << "\t";
+            if (result._solution.size()) cout << moves[i];
+            cout << "\t" << dealTimes[i] << "\t" << dealAdvances[i] << "\t" << dealClosed[i] << flush;
+        }
+        cout << endl;
+
+        if (Finished(codes[0]) && Finished(codes[1])) {
+            bothFinished += 1;
+            for (unsigned i = 0; i < 2; ++i) {
+                advances[i] += dealAdvances[i];
+                closed[i] += dealClosed[i];
+                times[i] += dealTimes[i];
+            }
+            if (codes[0] != codes[1] || moves[0] != moves[1])
+                mismatches.push_back(sample);
+        } else if (Finished(codes[0])) {
+            onlyA.push_back(sample);
+        } else if (Finished(codes[1])) {
+            onlyB.push_back(sample);
+        }
+        seed +=  spec._incr;
+    }
+
+    auto Change = [](double a, double b) {
+        ostringstream out;
+        out.precision(3);
+        out << (b >= a ? "+" : "") << (a ? 100.*(b-a)/a : 0.) << "%";
+        return out.str();
+    };
+    auto Rows = [](const char* label, const vector<unsigned>& rows) {
+        cout << "# " << label << ":";
+        for (unsigned row: rows) cout << " " << row;
+        cout << endl;
+    };
+    cout << "# " << bothFinished << " deals both finished" << endl;
+    cout << "#\tadvances\tclosed\ttime" << endl;
+    cout << "# A\t" << advances[0] << "\t" << closed[0] << "\t" << times[0] << endl;
+    cout << "# B\t" << advances[1] << "\t" << closed[1] << "\t" << times[1] << endl;
+    cout << "# B-A\t" << Change(advances[0], advances[1]) << "\t" 
+         << Change(closed[0], closed[1]) << "\t" << Change(times[0], times[1]) << endl;
+    Rows("finished only with A", onlyA);
+    Rows("finished only with B", onlyB);
+    Rows("minimum solutions differ", mismatches);
+    return mismatches.empty() ? 0 : 1;
+}
+
 int main(int argc, char * argv[])
 {
     Specification spec = GetSpec(argc, argv);
 
     unsigned recycleLimit(-1);
     if (spec._vegas) recycleLimit = spec._drawSpec-1;
+    if (spec._compare) return Compare(spec, recycleLimit);
     
     // If the row number starts at 1, insert a header line
-    if (spec._begin == 1)
-        cout << "row\tseed\tthreads\tdraw\toutcome\tmoves\tpasses\ttime\tfringe\tmvtree\tadvances\tclosed" << endl;
+    if (spec._begin == 1) {
+        cout << "row\tseed\tthreads\tdraw\toutcome\tmoves\tpasses\ttime\tfringe\tmvtree\tadvances\tclosed";
+#ifdef KSOLVE_RESTORE_CACHE
+        cout << "\tcachehits\tcachemisses";
+#endif
+        cout << endl;
+    }
     unsigned threads = (spec._threads > 0)
                         ? spec._threads
                         : DefaultThreads();
@@ -141,8 +314,10 @@ int main(int argc, char * argv[])
             << threads << "\t"			 
             << spec._drawSpec << "\t" << flush;
         auto startTime = steady_clock::now();
-        KSolveAStarResult result = KSolveAStar(game,spec._mvLimit,spec._threads);
+        KSolveAStarResult result = KSolveAStar(game,spec._mvLimit,spec._threads,spec._moveTreeDirectory,
+                                               spec._talonLookAhead,0,spec._heuristic);
         duration<double, std::milli> elapsed = steady_clock::now() - startTime;
+        CheckMapping(spec, result);
 
         if (result._solution.size()) 
             TestSolution(game, result._solution);
@@ -170,6 +345,10 @@ int main(int argc, char * argv[])
 
         cout << "\t" << result._stateCount;
 
+#ifdef KSOLVE_RESTORE_CACHE
+        cout << "\t" << result._restoreCacheHits << "\t" << result._restoreCacheMisses;
+#endif
+
         cout << endl;
 
         seed +=  spec._incr;
@@ -0,0 +1,162 @@
+// snapshot-benchmark.cpp
+//
+// Compares two ways to return a Game to a position it has been in:
+// Restore() from a GameSnapshot, and Deal() followed by replaying the
+// moves that led there.  It plays random moves from random deals,
+// saving a snapshot and the moves made at each step, and then times
+// Save(), Restore() and replaying on all of them.
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <random>
+
+#include "Game.hpp"
+
+using namespace std;
+using namespace KSolveNames;
+
+struct Specs
+{
+    unsigned deals{1000};
+    unsigned moves{20};
+    unsigned reps{100};
+    unsigned seed{1};
+    unsigned draw{1};
+};
+
+static unsigned GetUnsignedInt(int argc, char* argv[], int i)
+{
+    if (i >= argc) {
+        cerr << "Missing argument after \"" << argv[i-1] << "\"\n";
+        exit(4);
+    }
+    try {
+        return stoul(argv[i]);
+    }
+    catch (...) {
+        cerr << "Invalid argument after \"" << argv[i-1] << "\": \"" << argv[i] << "\"\n";
+        exit(4);
+    }
+}
+
+static Specs GetSpecs(int argc, char* argv[])
+{
+    Specs result;
+    for (int i = 1; i < argc; ++i){
+        const string arg = argv[i];
+        if (arg == "-n" || arg == "--deals") {
+            result.deals = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-m" || arg == "--moves") {
+            result.moves = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-r" || arg == "--reps") {
+            result.reps = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-s" || arg == "--seed") {
+            result.seed = GetUnsignedInt(argc, argv, ++i);
+        } else if (arg == "-d" || arg == "--draw") {
+            result.draw = GetUnsignedInt(argc, argv, ++i);
+        } else {
+            cerr << "snapshot-benchmark - times Game::Save() and Restore() against replaying moves\n\n";
+            cerr << "-n # or --deals #       Number of random deals to play (default 1000)\n";
+            cerr << "-m # or --moves #       Random MoveSpecs to make in each (default 20)\n";
+            cerr << "-r # or --reps #        Times to run each test on all the positions (default 100)\n";
+            cerr << "-s # or --seed #        Seed for the deals and the moves (default 1)\n";
+            cerr << "-d # or --draw #        Cards to draw from the stock (default 1)\n";
+            exit(4);
+        }
+    }
+    return result;
+}
+
+// A position: the moves from the deal that led to it and its snapshot
+struct Position
+{
+    unsigned _deal;
+    unsigned _nMoves;
+    GameSnapshot _snapshot;
+};
+
+struct Inputs
+{
+    vector<Game> _games;            // one for each deal
+    vector<Moves> _moves;           // the moves made in each
+    vector<Position> _positions;
+};
+
+static Inputs CollectInputs(const Specs& specs)
+{
+    Inputs result;
+    mt19937 rng(specs.seed);
+    for (unsigned seed = specs.seed; seed < specs.seed+specs.deals; ++seed) {
+        Game game(NumberedDeal(seed), specs.draw);
+        Moves movesMade;
+        for (unsigned imv = 0; imv < specs.moves; ++imv) {
+            const QMoves avail = game.AvailableMoves(movesMade);
+            if (avail.empty()) break;
+            const MoveSpec mv = avail[rng()%avail.size()];
+            game.MakeMove(mv);
+            movesMade.push_back(mv);
+            result._positions.push_back(
+                {unsigned(result._games.size()), unsigned(movesMade.size()), game.Save()});
+        }
+        result._games.push_back(game);
+        result._moves.push_back(movesMade);
+    }
+    return result;
+}
+
+// Run f on each position reps times.  Return the sum of its results
+// and the nanoseconds per call.
+template <class Func>
+static pair<uint64_t,double> Time(const vector<Position>& positions, unsigned reps, Func f)
+{
+    uint64_t sum = 0;
+    const auto startTime = chrono::steady_clock::now();
+    for (unsigned rep = 0; rep < reps; ++rep) {
+        for (const auto& position: positions) {
+            sum += f(position);
+        }
+    }
+    const double elapsed = (chrono::steady_clock::now() - startTime)/1.0ns;
+    return {sum, elapsed/reps/positions.size()};
+}
+
+int main(int argc, char* argv[])
+{
+    const Specs specs = GetSpecs(argc, argv);
+    Inputs inputs = CollectInputs(specs);
+    cout << inputs._positions.size() << " positions, "
+         << specs.moves << " moves or fewer from the deal\n";
+    cout.precision(3);
+
+    const auto replay = Time(inputs._positions, specs.reps,
+        [&inputs](const Position& pos) {
+            Game& game = inputs._games[pos._deal];
+            game.Deal();
+            for (unsigned i = 0; i < pos._nMoves; ++i) {
+                game.MakeMove(inputs._moves[pos._deal][i]);
+            }
+            return game.Hash();
+        });
+    const auto restore = Time(inputs._positions, specs.reps,
+        [&inputs](const Position& pos) {
+            Game& game = inputs._games[pos._deal];
+            game.Restore(pos._snapshot);
+            return game.Hash();
+        });
+    const auto save = Time(inputs._positions, specs.reps,
+        [&inputs](const Position& pos) {
+            const GameSnapshot snapshot = inputs._games[pos._deal].Save();
+            return uint64_t(snapshot._cards[pos._nMoves%CardsPerDeck].Value());
+        });
+    cout << "Deal() and replay\t" << replay.second << " ns\n";
+    cout << "Restore()\t\t" << restore.second << " ns\n";
+    cout << "Save()\t\t\t" << save.second << " ns\n";
+
+    if (replay.first != restore.first) {
+        cerr << "Restore() and replaying reached different positions\n";
+        return 1;
+    }
+    return 0;
+}
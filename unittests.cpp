@@ -1,13 +1,18 @@
-// Tests for Game.cpp KSolveAStar.cpp
+// Tests for Game.cpp BitGame.cpp Kernels.cpp KSolveAStar.cpp
 
 #include "KSolveAStar.hpp"
 #include "GameStateMemory.hpp"
+#include "BitGame.hpp"
+#include "Talon.hpp"
+#include "Kernels.hpp"
+#include "MappedFileAllocator.hpp"
 #include <cassert>
 #include <iostream>
 #include <iomanip>	  // for setw()
 #include <cstdlib>
 #include <algorithm>  // for find()
 #include <random>
+#include <filesystem>	// for temp_directory_path()
 #include "frystl/mf_vector.hpp"
 
 using namespace std;
@@ -123,6 +128,24 @@ static unsigned FoundationCardCount(const Game& game)
 	return result;
 }
 
+// Return a description of the current position of game
+static GamePosition Position(const Game& game)
+{
+	GamePosition position;
+	position._waste.assign(game.WastePile().begin(), game.WastePile().end());
+	position._stock.assign(game.StockPile().begin(), game.StockPile().end());
+	for (unsigned i = 0; i < TableauSize; ++i) {
+		const Pile& pile = game.Tableau()[i];
+		position._tableau[i].assign(pile.begin(), pile.end());
+		position._downCount[i] = pile.DownCount();
+	}
+	for (unsigned suit = 0; suit < SuitsPerDeck; ++suit) {
+		position._foundationSizes[suit] = game.Foundation()[suit].size();
+	}
+	position._recycleCount = game.RecycleCount();
+	return position;
+}
+
 
 // enum KSolveAStarResult {SolvedMinimal, Solved, GaveUp, Impossible,MemoryExceeded};
 void PrintOutcome(Game& game, const KSolveAStarResult& rslt)
@@ -219,6 +242,50 @@ static void Peek(const GameState& st)
 }
 std::minstd_rand rng;
 
+// Return the sorted names of moves
+static vector<string> MoveSet(const QMoves& moves)
+{
+	vector<string> result;
+	for (auto mv: moves) result.push_back(Peek(mv));
+	ranges::sort(result);
+	return result;
+}
+
+// Return MoveSet() of the moves game (a Game or a BitGame) offers 
+// after movesMade, leaving its dominant move cache as it was
+template <class G>
+static vector<string> MoveSet(G game, const Moves& movesMade)
+{
+	game.ClearMoveCache();
+	return MoveSet(game.AvailableMoves(movesMade));
+}
+
+// Make up to steps random moves in game, appending each to movesMade,
+// and call check(mv, false) after each.  If backOneIn is not zero, 
+// about one step in backOneIn instead takes back the last move made
+// and calls check(mv, true).  Stop when no move is available.
+template <class Check>
+static void RandomWalk(Game& game, Moves& movesMade, unsigned steps, 
+	unsigned backOneIn, Check check)
+{
+	for (unsigned step = 0; step < steps; ++step) {
+		if (backOneIn && movesMade.size() && rng()%backOneIn == 0) {
+			const MoveSpec mv = movesMade.back();
+			game.UnMakeMove(mv);
+			game.ClearMoveCache();
+			movesMade.pop_back();
+			check(mv, true);
+		} else {
+			const QMoves avail = game.AvailableMoves(movesMade);
+			if (avail.empty()) break;
+			const MoveSpec mv = avail[rng()%avail.size()];
+			game.MakeMove(mv);
+			movesMade.push_back(mv);
+			check(mv, false);
+		}
+	}
+}
+
 int main()
 {
 	// Test Card
@@ -303,6 +370,71 @@ int main()
 		}
 		assert (FoundationCardCount(sol) == 0);
 	}
+	{
+		// Test the talon step cache, including a change of draw setting
+		auto Same = [](const TalonSteps& a, const TalonSteps& b) {
+			return ranges::equal(a, b, [](TalonStep x, TalonStep y) {
+				return x._wasteSize == y._wasteSize && x._nMoves == y._nMoves 
+					&& x._recycle == y._recycle;});
+		};
+		for (unsigned draw: {1, 3, 1}) {
+			for (unsigned waste = 0; waste <= 24; ++waste) {
+				for (unsigned stock = 0; waste+stock <= 24; ++stock) {
+					for (unsigned recycles = 0; recycles <= 1; ++recycles) {
+						assert(Same(CachedTalonSteps(waste, stock, draw, recycles),
+							SimulateTalon(waste, stock, draw, recycles)));
+					}
+				}
+			}
+		}
+	}
+	{
+		// Differential test of BitGame against Game.  Play random
+		// moves in both, sometimes taking one back, and check that 
+		// they offer the same moves and hold the same cards.
+		rng.seed(7);
+		for (unsigned seed = 1; seed <= 60; ++seed) {
+			const unsigned draw = 1 + 2*(seed%2);
+			const CardDeck deal = NumberedDeal(seed);
+			Game game(deal, draw, seed%3);
+			BitGame bitGame(deal, draw, seed%3);
+			Moves movesMade;
+			RandomWalk(game, movesMade, 300, 4, [&](MoveSpec mv, bool undone) {
+				if (undone) bitGame.UnMakeMove(mv);
+				else bitGame.MakeMove(mv);
+				assert(MoveSet(game, movesMade) == MoveSet(bitGame, movesMade));
+				for (const auto& pile: std::as_const(game).AllPiles()) {
+					assert(PileVec(pile) == bitGame.Cards(pile.Code()));
+					assert(!pile.IsTableau() || pile.UpCount() == bitGame.UpCount(pile.Code()));
+				}
+				assert(game.GameOver() == bitGame.GameOver());
+			});
+		}
+	}
+	{
+		// Leaving out a pruning rule may only add moves.
+		auto Without = []<PruneRule Rule>(Game game, const Moves& movesMade) {
+			game.ClearMoveCache();
+			return game.AvailableMoves<Rules<0,true,PruneAll & ~Rule>>(movesMade);
+		};
+		rng.seed(11);
+		for (unsigned seed = 1; seed <= 30; ++seed) {
+			Game game(NumberedDeal(seed), 1 + 2*(seed%2), seed%3);
+			Moves movesMade;
+			RandomWalk(game, movesMade, 200, 0, [&](MoveSpec, bool) {
+				const auto without = {
+					MoveSet(Without.operator()<PruneDominant>(game, movesMade)),
+					MoveSet(Without.operator()<PruneReverseDominant>(game, movesMade)),
+					MoveSet(Without.operator()<PruneXYZ>(game, movesMade)),
+					MoveSet(Without.operator()<PruneKingOnce>(game, movesMade)),
+					MoveSet(Without.operator()<PruneKingSpace>(game, movesMade))};
+				const auto moves = MoveSet(game, movesMade);
+				for (const auto& more: without) {
+					assert(ranges::includes(more, moves));
+				}
+			});
+		}
+	}
 	{
 		// Test MoveSpec class and Peek functions
 		assert(sizeof(MoveSpec)==4);
@@ -368,6 +500,36 @@ int main()
 		assert(!XYZ_Move(MoveSpec(Tableau2,Tableau4,3,4),made));	// Tableau4 was changed at E
 		assert(!XYZ_Move(MoveSpec(Tableau1,Tableau4,3,4),made));	// E flipped Tableau4
 	}
+	{
+		// Test that LastTouchSequence gets the same XYZ_Move results
+		// as scanning, after push_back(), pop_back() and append()
+		rng.seed(35);
+		for (unsigned seed = 1; seed <= 20; ++seed) {
+			Game game(NumberedDeal(seed));
+			Moves movesMade;
+			LastTouchSequence<200> tracked;
+			LastTouchSequence<200> appended;
+			RandomWalk(game, movesMade, 150, 4, [&](MoveSpec mv, bool undone) {
+				if (undone) tracked.pop_back();
+				else tracked.push_back(mv);
+				appended.clear();
+				appended.append(movesMade.begin(), movesMade.end(), MoveCount(movesMade));
+				assert(tracked.MoveCount() == appended.MoveCount());
+				for (unsigned y = TableauBase; y < PileCount; ++y) {
+					if (y == Stock) continue;
+					for (unsigned z = TableauBase; z < PileCount; ++z) {
+						if (z == y || z == Stock) continue;
+						for (unsigned n = 1; n <= 2; ++n) {
+							MoveSpec trial(PileCodeT(y), PileCodeT(z), n, false);
+							const bool scanned = XYZ_Scan(trial, movesMade);
+							assert(tracked.XYZ_Move(trial) == scanned);
+							assert(appended.XYZ_Move(trial) == scanned);
+						}
+					}
+				}
+			});
+		}
+	}
 	{
 		// Test GameState creation.
 		vector<string> deal102 {
@@ -398,6 +560,7 @@ int main()
 					movesMade.push_back(move);
 					Validate(game);
 					GameState state(game,0);
+					assert(Hasher()(state) == game.Hash());
 					auto pMatch = find(states.begin(),states.end(),state);
 					if (pMatch!=states.end()){
 						// state matches a previous GameState.  See if 
@@ -533,5 +696,307 @@ int main()
 		TestSolution(g41092, outcome._solution);
 		assert(MoveCount(outcome._solution) == 105);
 	}
+	{
+		// Solve from a position part way through a minimal solution of
+		// game 36394.  The rest of that solution is minimal from there.
+		Game game(NumberedDeal(36394), 1, 8);
+		auto outcome = KSolveAStar(game,700'000);
+		const Moves head(outcome._solution.begin(), outcome._solution.begin()+40);
+		for (auto mv: head) game.MakeMove(mv);
+
+		const GamePosition position = Position(game);
+		assert(PositionError(position).empty());
+
+		Game mid(position, 1, 8);
+		assert(Peek(mid) == Peek(game));
+		assert(mid.Hash() == game.Hash());
+		auto rest = KSolveAStar(mid,700'000);
+		assert(rest._code == SolvedMinimal);
+		assert(MoveCount(rest._solution) == 109 - MoveCount(head));
+		TestSolution(mid, rest._solution);
+		assert(Peek(mid) == Peek(game));
+		XMoves xms = MakeXMoves(rest._solution, mid.DrawSetting(),
+			mid.StockPile().size(), mid.WastePile().size());
+		TestSolution(mid, xms);
+
+		// Positions that can't arise in a game
+		GamePosition bad = position;
+		bad._foundationSizes[0] += 1;
+		assert(PositionError(bad).size());
+		bad = position;
+		bad._downCount[0] = 1;
+		assert(PositionError(bad).size());
+		bad = position;
+		bad._stock.push_back(Card(Card::Clubs, Card::Ace));
+		assert(PositionError(bad).size());
+	}
+	{
+		// Play a minimal solution of game 36394 until the rest can be
+		// auto-completed.  AutoComplete() must win in exactly the moves
+		// the minimal solution has left, and so must the solver from 
+		// there and from the position one move earlier.  With dominant
+		// moves pruned, the solver would simply play the foundation 
+		// moves one at a time, so that rule is off here.  Advance() must
+		// then auto-complete the root of the first search and the 
+		// winning child of the second, so the main loop never runs.
+		Game game(NumberedDeal(36394), 1, 8);
+		const auto outcome = KSolveAStar(game,700'000);
+		assert(outcome._code == SolvedMinimal);
+		const unsigned total = MoveCount(outcome._solution);
+		Moves head;
+		GamePosition before;
+		for (auto mv: outcome._solution) {
+			if (game.CanAutoComplete()) break;
+			before = Position(game);
+			game.MakeMove(mv);
+			head.push_back(mv);
+		}
+		assert(game.CanAutoComplete());
+		assert(!game.GameOver());
+		const unsigned left = total - MoveCount(head);
+		assert(MinimumMovesLeft(game) == left);
+		const GamePosition position = Position(game);
+
+		Moves finish;
+		game.AutoComplete(finish);
+		assert(game.GameOver());
+		assert(FoundationCardCount(game) == CardsPerDeck);
+		for (const Pile& pile: game.Tableau()) assert(pile.empty());
+		assert(MoveCount(finish) == left);
+
+		Game ready(position, 1, 8);
+		auto rest = KSolveAStar(ready,700'000,1,"",MaxTalonLookAhead,PruneDominant);
+		assert(rest._code == SolvedMinimal);
+		assert(MoveCount(rest._solution) == left);
+		TestSolution(ready, rest._solution);
+		assert(rest._advances == 0);
+
+		Game almost(before, 1, 8);
+		assert(!almost.CanAutoComplete());
+		rest = KSolveAStar(almost,700'000,1,"",MaxTalonLookAhead,PruneDominant);
+		assert(rest._code == SolvedMinimal);
+		assert(MoveCount(rest._solution) == left + head.back().NMoves());
+		TestSolution(almost, rest._solution);
+		assert(rest._advances == 0);
+	}
+	{
+		// Test Deadlocked().  Once a game is deadlocked, it stays that way.
+		// Until the talon is exhausted, it can't become deadlocked, 
+		// as the solver assumes.
+		rng.seed(5);
+		unsigned deadlocks = 0;
+		for (unsigned seed = 1; seed <= 300; ++seed) {
+			Game game(NumberedDeal(seed), 1 + 2*(seed%2), seed%3);
+			Moves movesMade;
+			bool wasDeadlocked = Deadlocked(game);
+			RandomWalk(game, movesMade, 150, 0, [&](MoveSpec mv, bool) {
+				const bool deadlocked = Deadlocked(game);
+				assert(deadlocked || !wasDeadlocked);
+				assert(!deadlocked || wasDeadlocked || 
+					(mv.IsStockMove() && game.RecycleCount() == game.RecycleLimit()));
+				deadlocks += deadlocked;
+				wasDeadlocked = deadlocked;
+			});
+		}
+		assert(deadlocks);
+
+		// Deal 74 is deadlocked: the four of spades can't move.
+		Game g74(NumberedDeal(74));
+		assert(Deadlocked(g74));
+		auto outcome = KSolveAStar(g74,1'000'000,1);
+		assert(outcome._code == Impossible);
+		assert(outcome._advances == 0);
+	}
+	{
+		// The misorder counts Game keeps as moves are made and unmade
+		// match those counted afresh by Restore().  CrossPileBlocks()
+		// drops by one at most with each move, and only with a move
+		// that is not to a foundation pile.
+		rng.seed(9);
+		for (unsigned seed = 1; seed <= 50; ++seed) {
+			Game game(NumberedDeal(seed), 1 + 2*(seed%2));
+			Game fresh(game);
+			Moves movesMade;
+			unsigned blocks = game.CrossPileBlocks();
+			RandomWalk(game, movesMade, 150, 4, [&](MoveSpec mv, bool undone) {
+				assert(undone || game.CrossPileBlocks() + !IsFoundation(mv.To()) >= blocks);
+				blocks = game.CrossPileBlocks();
+				fresh.Restore(game.Save());
+				assert(game.TableauMisorders() == fresh.TableauMisorders());
+				assert(game.WasteMisorders() == fresh.WasteMisorders());
+				assert(game.CrossPileBlocks() == fresh.CrossPileBlocks());
+			});
+		}
+	}
+	{
+		// MinimumMovesLeft() never drops by more than the moves made,
+		// with any draw setting and recycle limit, and with any set of
+		// HeuristicTerms.
+		rng.seed(11);
+		for (unsigned seed = 1; seed <= 200; ++seed) {
+			const unsigned draw = 1 + seed%4;
+			Game game(NumberedDeal(seed), draw, seed%5 < 3 ? seed%5 : -1);
+			Moves movesMade;
+			std::array<unsigned,FullHeuristic+1> minMoves;
+			for (unsigned h = 0; h <= FullHeuristic; ++h) {
+				minMoves[h] = MinimumMovesLeft(game, h);
+			}
+			RandomWalk(game, movesMade, 150, 0, [&](MoveSpec mv, bool) {
+				for (unsigned h = 0; h <= FullHeuristic; ++h) {
+					const unsigned left = MinimumMovesLeft(game, h);
+					assert(left + mv.NMoves() >= minMoves[h]);
+					minMoves[h] = left;
+				}
+			});
+		}
+	}
+	{
+		// Every heuristic policy finds a minimum solution; the full one
+		// searches least.
+		Game game(NumberedDeal(36392), 3);
+		const auto full = KSolveAStar(game,1'000'000,1);
+		assert(full._code == SolvedMinimal);
+		for (unsigned heuristic: {0U, unsigned(TableauMisorderTerm), 
+				unsigned(CrossPileTerm), unsigned(TalonMisorderTerm)}) {
+			const auto outcome = KSolveAStar(game,1'000'000,1,"",MaxTalonLookAhead,0,heuristic);
+			assert(outcome._code == SolvedMinimal);
+			assert(MoveCount(outcome._solution) == MoveCount(full._solution));
+			assert(outcome._advances >= full._advances);
+		}
+	}
+	{
+		// The five of clubs waits for the five of diamonds, which waits
+		// for the five of hearts, which waits for the five of clubs.
+		// One of them must move to the tableau before going home, though
+		// no two wait for each other.
+		Game::TableauType tableau{Tableau1,Tableau2,Tableau3,Tableau4,Tableau5,Tableau6,Tableau7};
+		auto Deal2 = [&](unsigned i, Card::SuitT under, Card::SuitT over) {
+			tableau[i].Push(Card(under, Card::Ace));
+			tableau[i].Push(Card(over, Card::RankT(4)));
+			tableau[i].SetDownCount(1);
+		};
+		Deal2(1, Card::Hearts, Card::Clubs);
+		Deal2(2, Card::Clubs, Card::Diamonds);
+		Deal2(3, Card::Diamonds, Card::Hearts);
+		assert(Game::CrossPileBlocks(tableau) == 1);
+		tableau[3].clear();
+		assert(Game::CrossPileBlocks(tableau) == 0);
+	}
+	{
+		// Limit talon look-ahead.  Deal 1 takes 95 moves without a limit.
+		Game game(NumberedDeal(1));
+		auto outcome = KSolveAStar(game,9'600'000,1,"",8);
+		assert(outcome._code == Solved);
+		TestSolution(game, outcome._solution);
+		assert(MoveCount(outcome._solution) >= 95);
+		assert(game.TalonLookAhead() == MaxTalonLookAhead);
+
+		// deal3 is impossible in one pass, but a limited search can't prove it
+		Game g3(Cards(deal3), 1, 0);
+		outcome = KSolveAStar(g3,9'600'000,1,"",1);
+		assert(outcome._code == GaveUp);
+	}
+	{
+		// MappedFileAllocator maps a file in a directory it can write,
+		// and falls back to the heap in one that does not exist.  A
+		// copied container maps a file of its own; a moved one takes
+		// the mapping along.
+		using MappedVector = std::vector<unsigned, MappedFileAllocator<unsigned>>;
+		const std::string temp = std::filesystem::temp_directory_path().string();
+		MappedVector mapped{MappedFileAllocator<unsigned>(temp)};
+		mapped.reserve(100'000);
+		for (unsigned i = 0; i < 1000; ++i) mapped.push_back(i);
+		MappedVector heap{MappedFileAllocator<unsigned>(temp + "/no/such/directory")};
+		heap.assign(mapped.begin(), mapped.end());
+		assert(heap == mapped);
+		assert(!heap.get_allocator().IsMapped());
+		MappedVector copy(mapped);
+		assert(copy == mapped);
+#ifdef KSOLVE_HAS_MMAP
+		assert(mapped.get_allocator().IsMapped());
+		assert(copy.get_allocator().IsMapped());
+		assert(!(copy.get_allocator() == mapped.get_allocator()));
+		assert(!(heap.get_allocator() == mapped.get_allocator()));
+#endif
+		const unsigned* data = mapped.data();
+		MappedVector moved(std::move(mapped));
+		assert(moved.data() == data && moved.size() == 1000);
+		heap = std::move(moved);
+		assert(heap.data() == data);
+#ifdef KSOLVE_HAS_MMAP
+		assert(heap.get_allocator().IsMapped());
+#endif
+	}
+	{
+		// Test Game::Save() and Restore().  Play randomly, saving now and 
+		// then, and Restore() each snapshot to a game that has moved on
+		// and to a fresh one.  Each must match a copy made at the save.
+		rng.seed(38);
+		for (unsigned rep = 0; rep < 200; ++rep) {
+			const unsigned draw = rep%2 ? 3 : 1;
+			Game game(NumberedDeal(rep+1), draw, rep%3);
+			Moves movesMade;
+			std::vector<GameSnapshot> snapshots;
+			std::vector<Game> copies;
+			std::vector<unsigned> moveCounts;
+			RandomWalk(game, movesMade, 150, 0, [&](MoveSpec, bool) {
+				if (rng()%8 == 0) {
+					snapshots.push_back(game.Save());
+					copies.push_back(game);
+					moveCounts.push_back(movesMade.size());
+				}
+			});
+			Game fresh(NumberedDeal(rep+1), draw, rep%3);
+			for (unsigned i = 0; i < snapshots.size(); ++i) {
+				const Game& copy = copies[i];
+				const Moves stem(movesMade.begin(), movesMade.begin()+moveCounts[i]);
+				for (Game* target: {&game, &fresh}) {
+					target->Restore(snapshots[i]);
+					assert(std::as_const(*target).AllPiles() == copy.AllPiles());
+					assert(target->RecycleCount() == copy.RecycleCount());
+					assert(target->TableauCodes() == copy.TableauCodes());
+					assert(target->Hash() == copy.Hash());
+					assert(MoveSet(target->AvailableMoves(stem)) == MoveSet(copy, stem));
+				}
+			}
+		}
+	}
+	{
+		// Test that every set of kernels agrees with the scalar set
+		const auto kernelSets = AvailableKernels();
+		const Kernels& scalar = *kernelSets[0];
+		assert(&BestKernels() == kernelSets.back());
+		assert(&Game(NumberedDeal(1)).KernelSet() == kernelSets.back());
+		rng.seed(37);
+		for (const Kernels* kernels: kernelSets) {
+			// A sorting network sorts everything if it sorts all 0-1 inputs
+			for (unsigned bits = 0; bits < (1U<<TableauSize); ++bits) {
+				TableauCodeArray codes, sorted;
+				for (unsigned i = 0; i < TableauSize; ++i) codes[i] = bits>>i & 1;
+				kernels->_sortTableauCodes(codes, sorted);
+				assert(ranges::is_sorted(sorted));
+				assert(ranges::count(sorted, 1U) == std::popcount(bits));
+			}
+			for (unsigned rep = 0; rep < 1000; ++rep) {
+				TableauCodeArray codes, sorted, expected;
+				for (auto& code: codes) code = rng() % 4 ? rng() & 0x1fffff : 0;
+				kernels->_sortTableauCodes(codes, sorted);
+				scalar._sortTableauCodes(codes, expected);
+				assert(sorted == expected);
+
+				CardDeck deck(NumberedDeal(rep+1));
+				PileVec pile(deck.begin(), deck.begin()+24);
+				for (unsigned n = 0; n <= 24; ++n) {
+					assert(kernels->_misorderCount(pile, n) == scalar._misorderCount(pile, n));
+				}
+				for (unsigned first = 0; first <= 8; ++first) {
+					for (unsigned n = 0; n <= 16; ++n) {
+						assert(kernels->_majorSuitBits(pile, first, n)
+							== scalar._majorSuitBits(pile, first, n));
+					}
+				}
+			}
+		}
+	}
 	cout << "unittests finished OK" << endl;
 }